@@ -30,14 +30,138 @@
 #include <stdio.h>
 
 
+/// Data is placed in extents -- runs of consecutive sectors -- so that
+/// reading a file sequentially seldom seeks, and mostly hits the track
+/// buffer of the disk.
+///
+/// * A file grows in place, into the sectors following its last one, while
+///   they are free.
+/// * When it cannot, a new extent is started where there is room for the
+///   sectors needed plus a preallocation window, which grows with the file,
+///   both after the extent, for the file to grow into, and before it, for
+///   whichever file ends right there.
+/// * Extents no longer than a track are kept within one track when
+///   possible.
+
+/// Smallest and largest preallocation window, in sectors.
+static const unsigned MIN_PREALLOCATION = 4;
+static const unsigned MAX_PREALLOCATION = SECTORS_PER_TRACK;
+
+/// Return the preallocation window of a file of `sectors` sectors.
+static unsigned
+PreallocationWindow(unsigned sectors)
+{
+    return sectors < MIN_PREALLOCATION ? MIN_PREALLOCATION
+         : sectors > MAX_PREALLOCATION ? MAX_PREALLOCATION
+         : sectors;
+}
+
+/// Return the first sector of a run of `count` free sectors, looking from
+/// `goal` on, or -1 if there is none.  A run that fits in a track does not
+/// straddle two, if that can be avoided.
+static int
+FindExtent(Bitmap *freeMap, unsigned count, unsigned goal)
+{
+    if (count <= SECTORS_PER_TRACK) {
+        unsigned from = goal;
+        for (unsigned tries = 0; tries < NUM_TRACKS; tries++) {
+            int first = freeMap->FindRun(count, from);
+            if (first == -1) {
+                return -1;
+            }
+            unsigned track = first / SECTORS_PER_TRACK;
+            if ((first + count - 1) / SECTORS_PER_TRACK == track) {
+                return first;
+            }
+            from = (track + 1) * SECTORS_PER_TRACK % NUM_SECTORS;
+        }
+    }
+    return freeMap->FindRun(count, goal);
+}
+
+/// Return where to start a new extent of `count` sectors, leaving `window`
+/// free sectors around it, or -1 if there is no such room.
+static int
+FindRoom(Bitmap *freeMap, unsigned count, unsigned window, unsigned goal)
+{
+    int first = FindExtent(freeMap, window + count + window, goal);
+    if (first > 0 && freeMap->Test(first - 1)) {
+        first += window;  // Leave room to the file ending before.
+    }
+    return first;
+}
+
+/// Allocate `count` sectors into `sectors`, in as few extents as possible,
+/// starting at `goal` if it is free.  Return the sector following the last
+/// one allocated, where the file would best grow next.
+///
+/// There must be at least `count` free sectors.
+static unsigned
+AllocateSectors(Bitmap *freeMap, unsigned goal, unsigned *sectors,
+                unsigned count, unsigned window)
+{
+    while (count > 0) {
+        int first;
+        unsigned run = count;
+        if (goal < NUM_SECTORS && !freeMap->Test(goal)) {
+            first = goal;  // Grow in place.
+            run = 1;
+            while (run < count && goal + run < NUM_SECTORS
+                     && !freeMap->Test(goal + run)) {
+                run++;
+            }
+        } else {
+            first = FindRoom(freeMap, count, window, goal);
+            while (first == -1) {
+                first = FindExtent(freeMap, run, goal);
+                if (first == -1) {
+                    ASSERT(run > 1);
+                    run /= 2;
+                }
+            }
+        }
+        for (unsigned i = 0; i < run; i++) {
+            freeMap->Mark(first + i);
+            sectors[i] = first + i;
+        }
+        sectors += run;
+        count -= run;
+        goal = first + run;
+    }
+    return goal;
+}
+
+int
+FileHeader::PlaceHeader(Bitmap *freeMap, unsigned fileSize, unsigned goal)
+{
+    ASSERT(freeMap != nullptr);
+
+    unsigned sectors = DivRoundUp(fileSize, SECTOR_SIZE);
+    int sector = FindRoom(freeMap, 1 + sectors, PreallocationWindow(sectors),
+                          goal);
+    if (sector == -1) {
+        sector = freeMap->FindRun(1, goal);
+        if (sector == -1) {
+            return -1;
+        }
+    }
+    freeMap->Mark(sector);
+    return sector;
+}
+
 /// Initialize a fresh file header for a newly created file.  Allocate data
 /// blocks for the file out of the map of free disk blocks.  Return false if
 /// there are not enough free blocks to accomodate the new file.
 ///
+/// The tables of the second level of indirection, if needed, are placed
+/// after the data, so that they do not split it.
+///
 /// * `freeMap` is the bit map of free disk sectors.
-/// * `fileSize` is the bit map of free disk sectors.
+/// * `fileSize` is the number of bytes of the file.
+/// * `goal` is where the data would best start, usually right after the
+///   header.
 bool
-FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
+FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize, unsigned goal)
 {
     ASSERT(freeMap != nullptr);
 
@@ -48,9 +172,7 @@ FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
     raw.numBytes = fileSize;
 
     unsigned dataSectorCount = DataSectorCount();
-    unsigned indirectionSectorCount = 0;
-    if (UsesDoubleIndirection())
-        indirectionSectorCount = DivRoundUp(dataSectorCount, NUM_DIRECT);
+    unsigned indirectionSectorCount = IndirectionSectorCount();
     raw.numSectors = dataSectorCount + indirectionSectorCount;
     indirTable = std::vector<FileHeader*>(indirectionSectorCount);
 
@@ -58,37 +180,26 @@ FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
         return false;  // Not enough space.
     }
 
-    // En este caso raw.numBytes = dataSectorCount <= y no hay indirecciÃ³n.
-    if(raw.numBytes <= MAX_FILE_SIZE){
-        for (unsigned i = 0; i < raw.numSectors; i++)
-            raw.dataSectors[i] = freeMap->Find();
-    // En este caso raw.numBytes = dataSectorCount + indirectionSectorCount, por lo que hacemos indirecciÃ³n.
-    }else{
-        // Amount of bytes that still have to be allocated.
-        unsigned remainingBytes = raw.numBytes;
-
-        // Allocate the header tables.
-        for(unsigned i = 0; i < indirectionSectorCount; i++){
-            raw.dataSectors[i] = freeMap->Find();
-            FileHeader *dataHeader = new FileHeader;
-
-            // nextBlock is the amount of bytes the current FileHeader will
-            // store.
-            unsigned nextBlock;
-            if(remainingBytes <= MAX_FILE_SIZE)
-                nextBlock = remainingBytes;
-            else{
-                // Allocate as many bytes as possible.
-                nextBlock = MAX_FILE_SIZE;
-                remainingBytes -= MAX_FILE_SIZE;
-            }
-
-            dataHeader->Allocate(freeMap, nextBlock);
-            // Save the new FileHeader to the indirTable
-            indirTable.push_back(dataHeader);
-        }
+    if (!UsesDoubleIndirection()) {
+        AllocateSectors(freeMap, goal, raw.dataSectors, dataSectorCount,
+                        PreallocationWindow(dataSectorCount));
+        return true;
     }
 
+    // Amount of bytes that still have to be allocated.
+    unsigned remainingBytes = raw.numBytes;
+    for (unsigned i = 0; i < indirectionSectorCount; i++) {
+        unsigned nextBlock = remainingBytes < MAX_FILE_SIZE ? remainingBytes
+                                                            : MAX_FILE_SIZE;
+        remainingBytes -= nextBlock;
+
+        FileHeader *dataHeader = new FileHeader;
+        dataHeader->Allocate(freeMap, nextBlock, goal);
+        goal = dataHeader->LastDataSector() + 1;
+        indirTable[i] = dataHeader;
+    }
+    AllocateSectors(freeMap, goal, raw.dataSectors, indirectionSectorCount,
+                    0);
     return true;
 }
 
@@ -125,7 +236,7 @@ FileHeader::Deallocate(Bitmap *freeMap)
 void
 FileHeader::FetchFrom(unsigned sector)
 {
-    synchDisk->ReadSector(sector, (char *) &raw);
+    sectorCache->ReadSector(sector, (char *) &raw);
 
     unsigned indirectionSectorCount = IndirectionSectorCount();
     indirTable = std::vector<FileHeader*>(indirectionSectorCount);
@@ -145,7 +256,7 @@ FileHeader::FetchFrom(unsigned sector)
 void
 FileHeader::WriteBack(unsigned sector)
 {
-    synchDisk->WriteSector(sector, (char *) &raw);
+    sectorCache->WriteSector(sector, (char *) &raw);
 
     // Store all the headers of the next level of indirection.
     for(unsigned i = 0; i < indirTable.size(); i++)
@@ -177,21 +288,47 @@ FileHeader::FileLength() const
 
 /// Print the contents of the file header, and the contents of all the data
 /// blocks pointed to by the file header.
+///
+/// A file that needs double indirection lists its data in several tables,
+/// each of them the header of a piece of at most `MAX_FILE_SIZE` bytes;
+/// they are printed one after the other.
 void
 FileHeader::Print(const char *title)
 {
-    char *data = new char [SECTOR_SIZE];
-
     if (title == nullptr) {
         printf("File header:\n");
     } else {
         printf("%s file header:\n", title);
     }
 
-    printf("    size: %u bytes\n"
-           "    block indexes: ",
-           raw.numBytes);
+    printf("    size: %u bytes\n", raw.numBytes);
+
+    if (!UsesDoubleIndirection()) {
+        PrintData();
+        return;
+    }
+    printf("    table sectors: ");
+    for (unsigned i = 0; i < IndirectionSectorCount(); i++) {
+        printf("%u ", raw.dataSectors[i]);
+    }
+    printf("\n");
+    for (unsigned i = 0; i < indirTable.size(); i++) {
+        printf("    table in sector %u, %u bytes:\n",
+               raw.dataSectors[i], indirTable[i]->FileLength());
+        indirTable[i]->PrintData();
+    }
+}
+
+/// Print the indexes and contents of the data blocks of a header that
+/// points to them directly.
+void
+FileHeader::PrintData()
+{
+    ASSERT(!UsesDoubleIndirection());
 
+    char *data = new char [SECTOR_SIZE];
+
+    printf("    block indexes: ");
     for (unsigned i = 0; i < raw.numSectors; i++) {
         printf("%u ", raw.dataSectors[i]);
     }
@@ -199,7 +336,7 @@ FileHeader::Print(const char *title)
 
     for (unsigned i = 0, k = 0; i < raw.numSectors; i++) {
         printf("    contents of block %u:\n", raw.dataSectors[i]);
-        synchDisk->ReadSector(raw.dataSectors[i], data);
+        sectorCache->ReadSector(raw.dataSectors[i], data);
         for (unsigned j = 0; j < SECTOR_SIZE && k < raw.numBytes; j++, k++) {
             if (isprint(data[j])) {
                 printf("%c", data[j]);
@@ -234,96 +371,108 @@ unsigned
 FileHeader::IndirectionSectorCount() const{
     if(not UsesDoubleIndirection())
         return 0;
-    return DivRoundUp(sectorCount, NUM_DIRECT);
+    return DivRoundUp(DataSectorCount(), NUM_DIRECT);
 }
 
-bool
-FileHeader::Extend(Bitmap* freeMap, unsigned extendSize)
+/// Return the last sector holding data of a file that is not empty.
+unsigned
+FileHeader::LastDataSector() const
 {
-    if(extendSize == 0)
-        return true; // Nothing to be done.
+    ASSERT(raw.numBytes > 0);
 
-    unsigned oldNumBytes = raw.numBytes;
-    unsigned oldNumSectors = raw.numSectors;
-    bool oldDoubleIndirection = UsesDoubleIndirection();
+    if (UsesDoubleIndirection()) {
+        return indirTable.back()->LastDataSector();
+    }
+    return raw.dataSectors[DataSectorCount() - 1];
+}
 
-    raw.numBytes += extendSize;
-    unsigned dataSectorCount = DataSectorCount();
-    unsigned indirectionSectorCount = IndirectionSectorCount();
-    raw.numSectors = dataSectorCount + indirectionSectorCount;
+/// Add `extendSize` bytes to the end of the file, allocating the sectors
+/// they need.  Return false, changing nothing, if the file would be too
+/// large or there is not enough free space.
+///
+/// New data follows the last sector of the file if it can.  When the file
+/// outgrows the direct table, the table becomes the first one of the second
+/// level of indirection.
+///
+/// * `freeMap` is the bit map of free disk sectors.
+/// * `extendSize` is the number of bytes to add.
+/// * `goal` is where the data would best start, if the file is empty.
+bool
+FileHeader::Extend(Bitmap *freeMap, unsigned extendSize, unsigned goal)
+{
+    ASSERT(freeMap != nullptr);
 
-    // Check that the final size is small enough to:
-    //  - fit into a header with two indirection levels
-    //  - fit into disk
-    if (freeMap->CountClear() < raw.numSectors - oldNumSectors || INDIR_MAX_FILE_SIZE < raw.numBytes){
-        // Restore original values
-        raw.numBytes = oldNumBytes;
-        raw.numSectors = oldNumSectors;
-        return false;  // Not enough space.
+    if (extendSize == 0) {
+        return true;  // Nothing to be done.
     }
 
-    DEBUG('f', "There is enough disk size to extend the file.\n");
-
-    // The amount of bytes that still need to be allocated.
-    unsigned remainingBytes = extendSize;
+    unsigned newNumBytes = raw.numBytes + extendSize;
+    if (newNumBytes > INDIR_MAX_FILE_SIZE) {
+        return false;
+    }
+    unsigned oldDataSectors = DataSectorCount();
+    unsigned oldIndirectionSectors = IndirectionSectorCount();
+    unsigned newDataSectors = DivRoundUp(newNumBytes, SECTOR_SIZE);
+    unsigned newIndirectionSectors = newNumBytes > MAX_FILE_SIZE
+                                     ? DivRoundUp(newDataSectors, NUM_DIRECT)
+                                     : 0;
+    if (freeMap->CountClear() < newDataSectors + newIndirectionSectors
+                                  - oldDataSectors - oldIndirectionSectors) {
+        return false;  // Not enough space.
+    }
 
-    if(not oldDoubleIndirection){
-        if (oldNumBytes < SECTOR_SIZE) {
-            unsigned lastSectorChunk = SECTOR_SIZE - (oldNumBytes % SECTOR_SIZE);
-            remainingBytes -= lastSectorChunk;
-        }
+    if (raw.numBytes > 0) {
+        goal = LastDataSector() + 1;
+    }
 
-        // Fill the first level of indirection.
-        for(unsigned i = oldNumSectors; i < NUM_DIRECT and remainingBytes > 0; i++){
-            raw.dataSectors[i] = freeMap -> Find();
-            remainingBytes -= SECTOR_SIZE;
+    if (newIndirectionSectors == 0) {
+        AllocateSectors(freeMap, goal, raw.dataSectors + oldDataSectors,
+                        newDataSectors - oldDataSectors,
+                        PreallocationWindow(newDataSectors));
+    } else {
+        if (oldIndirectionSectors == 0) {
+            // The direct table moves to the second level.
+            FileHeader *first = new FileHeader;
+            *first->GetRaw() = raw;
+            indirTable.push_back(first);
         }
-
-        if (remainingBytes > 0){
-            FileHeader *fh = new FileHeader;
-            RawFileHeader *rfh = fh->GetRaw();
-            *rfh = raw;
-            rfh -> numBytes = MAX_FILE_SIZE;
-            rfh -> numSectors = NUM_DIRECT;
-            raw.dataSectors[0] = freeMap -> Find();
-
-            indirTable.push_back(fh);
+        for (unsigned i = 0; i < newIndirectionSectors; i++) {
+            unsigned offset = i * MAX_FILE_SIZE;
+            unsigned size = newNumBytes - offset < MAX_FILE_SIZE
+                            ? newNumBytes - offset : MAX_FILE_SIZE;
+            if (i < indirTable.size()) {
+                FileHeader *table = indirTable[i];
+                table->Extend(freeMap, size - table->FileLength(), goal);
+            } else {
+                FileHeader *table = new FileHeader;
+                table->Allocate(freeMap, size, goal);
+                indirTable.push_back(table);
+            }
+            goal = indirTable[i]->LastDataSector() + 1;
         }
+        AllocateSectors(freeMap, goal,
+                        raw.dataSectors + oldIndirectionSectors,
+                        newIndirectionSectors - oldIndirectionSectors, 0);
     }
 
-    if(remainingBytes > 0){
-        // Now the old table has more than one level of indirection.
-        // We start from the last occupied sector table.
-        FileHeader *fh = indirTable[indirTable.size() - 1];
-        RawFileHeader *rfh = fh -> GetRaw();
-
-        // The amount of free bytes in the last occupied sector table.
-        unsigned freeLastTable = MAX_FILE_SIZE - rfh->numBytes;
-
-        fh -> Extend(freeMap, remainingBytes < freeLastTable ? remainingBytes : freeLastTable);
-        remainingBytes -= freeLastTable;
-
-        // Allocate the necessary header tables.
-        for(unsigned i = indirTable.size(); i < indirectionSectorCount; i++){
-            raw.dataSectors[i] = freeMap -> Find();
-            FileHeader *dataHeader = new FileHeader;
-
-            // nextBlock is the amount of bytes the current FileHeader will
-            // store.
-            unsigned nextBlock;
-            if(remainingBytes <= MAX_FILE_SIZE)
-                nextBlock = remainingBytes;
-            else{
-                // Allocate as many bytes as possible.
-                nextBlock = MAX_FILE_SIZE;
-                remainingBytes -= MAX_FILE_SIZE;
-            }
+    raw.numBytes = newNumBytes;
+    raw.numSectors = newDataSectors + newIndirectionSectors;
+    return true;
+}
 
-            dataHeader -> Allocate(freeMap, nextBlock);
-            // Save the new FileHeader to the indirTable
-            indirTable.push_back(dataHeader);
+/// Count the extents -- runs of consecutive sectors -- holding the data of
+/// the file, in file order.
+unsigned
+FileHeader::CountExtents()
+{
+    unsigned extents = 0;
+    unsigned previous = 0;
+    for (unsigned i = 0; i < DataSectorCount(); i++) {
+        unsigned sector = ByteToSector(i * SECTOR_SIZE);
+        if (i == 0 || sector != previous + 1) {
+            extents++;
         }
+        previous = sector;
     }
-
-    return true;
-}
\ No newline at end of file
+    return extents;
+}
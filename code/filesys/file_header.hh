@@ -36,8 +36,8 @@ class FileHeader {
 public:
 
     /// Initialize a file header, including allocating space on disk for the
-    /// file data.
-    bool Allocate(Bitmap *bitMap, unsigned fileSize);
+    /// file data, near sector `goal`.
+    bool Allocate(Bitmap *bitMap, unsigned fileSize, unsigned goal = 0);
 
     /// De-allocate this file's data blocks.
     void Deallocate(Bitmap *bitMap);
@@ -64,7 +64,18 @@ public:
     /// system at a low level.
     RawFileHeader *GetRaw();
 
-    bool Extend(Bitmap *freeMap, unsigned extendSize);
+    /// Grow the file by `extendSize` bytes.  `goal` is where to put the
+    /// data of a file that has none yet.
+    bool Extend(Bitmap *freeMap, unsigned extendSize, unsigned goal = 0);
+
+    /// Return the number of runs of consecutive sectors holding the data.
+    unsigned CountExtents();
+
+    /// Choose a sector near `goal` for the header of a new file of
+    /// `fileSize` bytes, followed by free room for its data, and mark it
+    /// in `freeMap`.  Return -1 if the disk is full.
+    static int PlaceHeader(Bitmap *freeMap, unsigned fileSize,
+                           unsigned goal);
 
 private:
     RawFileHeader raw;
@@ -77,7 +88,10 @@ private:
 
     unsigned IndirectionSectorCount() const;
 
-    unsigned sectorCount;
+    unsigned LastDataSector() const;
+
+    /// Print the data blocks of a header without double indirection.
+    void PrintData();
 
 };
 
@@ -78,8 +78,8 @@ FileSystem::FileSystem(bool format)
     dirList = new DirectoryList();
     freeMapLock = new Lock ("File system free map lock");
 
+    freeMap = new Bitmap(NUM_SECTORS);
     if (format) {
-        Bitmap     *freeMap = new Bitmap(NUM_SECTORS);
         Directory  *dir     = new Directory();
         FileHeader *mapH    = new FileHeader;
         FileHeader *dirH    = new FileHeader;
@@ -121,14 +121,13 @@ FileSystem::FileSystem(bool format)
         // to hold the file data for the directory and bitmap.
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
-        freeMap->WriteBack(freeMapFile);     // flush changes to disk
+        freeMap->WriteBackDirty(freeMapFile);  // flush changes to disk
         dir->WriteBack(directoryFile);
 
         if (debug.IsEnabled('f')) {
             freeMap->Print();
             dir->Print();
 
-            delete freeMap;
             delete dir;
             delete mapH;
             delete dirH;
@@ -139,11 +138,13 @@ FileSystem::FileSystem(bool format)
         // Nachos is running.
         freeMapFile   = new OpenFile(FREE_MAP_SECTOR);
         directoryFile = new OpenFile(DIRECTORY_SECTOR);
+        freeMap->FetchFrom(freeMapFile);
     }
 }
 
 FileSystem::~FileSystem()
 {
+    delete freeMap;
     delete freeMapFile;
     delete directoryFile;
     delete openFiles;
@@ -211,10 +212,9 @@ FileSystem::Create(const char *name, unsigned initialSize, bool isDirectory)
         success = false;
     } else {
         freeMapLock->Acquire();
-        Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-        freeMap->FetchFrom(freeMapFile);
-        int sector = freeMap->Find();
-          // Find a sector to hold the file header.
+        int sector = FileHeader::PlaceHeader(freeMap, initialSize,
+                                             entry.sector);
+          // Find a sector to hold the file header, near its directory.
         if (sector == -1) {
             DEBUG('f', "No free block for file header\n");
             success = false;  
@@ -222,10 +222,11 @@ FileSystem::Create(const char *name, unsigned initialSize, bool isDirectory)
             bool shouldExtend = dir->Add(file.c_str(), sector, isDirectory);
             FileHeader *fh = dirFile->GetFileHeader();
             if (shouldExtend)
-                success = fh->Extend(freeMap, sizeof(DirectoryEntry));
+                success = fh->Extend(freeMap, sizeof(DirectoryEntry),
+                                     dirFile->GetSector() + 1);
             if (success) {
                 FileHeader *h = new FileHeader;
-                success = h->Allocate(freeMap, initialSize);
+                success = h->Allocate(freeMap, initialSize, sector + 1);
                 // Fails if no space on disk for data.
                 if (success) {
                     DEBUG('f', "Creating file success \n");
@@ -233,7 +234,7 @@ FileSystem::Create(const char *name, unsigned initialSize, bool isDirectory)
                     fh->WriteBack(dirFile->GetSector());
                     h->WriteBack(sector);
                     dir->WriteBack(dirFile);
-                    freeMap->WriteBack(freeMapFile);
+                    freeMap->WriteBackDirty(freeMapFile);
                     if (isDirectory) {
                         Directory* newDir = new Directory();
                         newDir->SetInitialValue(initialSize/sizeof(DirectoryEntry));
@@ -244,8 +245,10 @@ FileSystem::Create(const char *name, unsigned initialSize, bool isDirectory)
                 delete h;
             }
         }
+        if (!success) {
+            freeMap->FetchFrom(freeMapFile);  // Undo the allocations.
+        }
         freeMapLock->Release();
-        delete freeMap;
     }
     dirList->LockAcquire();
     dirLock->Release();
@@ -312,6 +315,10 @@ FileSystem::Open(const char *name)
 /// 3. Delete the space for its data blocks.
 /// 4. Write changes to directory, bitmap back to disk.
 ///
+/// A file that is open is taken out of its directory right away, but its
+/// header and data are only deleted once the last `OpenFile` for it is
+/// closed; see `Close`.
+///
 /// Return true if the file was deleted, false if the file was not in the
 /// file system.
 ///
@@ -334,7 +341,7 @@ FileSystem::Remove(const char *name)
     bool success = true;
     FilePath dirPath = currentThread->GetPath();
     dirPath.Merge(name);
-    dirPath.Split(); 
+    std::string file = dirPath.Split();
     DirectoryEntry currentDirEntry = FindPath(&dirPath);
     Lock* dirLock = dirList->OpenDirectory(currentDirEntry.sector);
     dirList->LockRelease();
@@ -359,24 +366,21 @@ FileSystem::Remove(const char *name)
         dirToDeleteLock->Release();
         dirList->CloseDirectory(dirEntry.sector);
         if (i < raw->tableSize || !dirList->CanRemove(dirEntry.sector)) {
-            delete toRemoveFile;
-            delete dirToRemove;
             success = false;
         }
+        delete toRemoveFile;
+        delete dirToRemove;
         if (success) {
-            std::string file = path.Split();
-            int dirSector = FindPath(&path).sector;
-            DeleteFromDisk(dirSector);
+            RemoveEntry(currentDirEntry.sector, file.c_str());
+            DeleteFromDisk(dirEntry.sector);
         }
         dirList->LockRelease();
     } else {
+        RemoveEntry(currentDirEntry.sector, file.c_str());
         openFiles->AcquireListLock();
-        if (openFiles->SetUpRemoval(dirEntry.sector)){
-            std::string file = path.Split();
-            int fileSector = FindPath(&path).sector;
-            DeleteFromDisk(fileSector);
+        if (!openFiles->SetUpRemoval(dirEntry.sector)) {
+            DeleteFromDisk(dirEntry.sector);
         }
-            
         openFiles->ReleaseListLock();
     }
     dirList->LockAcquire();
@@ -386,6 +390,34 @@ FileSystem::Remove(const char *name)
     return success;
 }
 
+/// Take the entry `name` out of the directory with header `dirSector`,
+/// whose lock must be held.
+void
+FileSystem::RemoveEntry(int dirSector, const char *name)
+{
+    OpenFile *dirFile = new OpenFile(dirSector);
+    Directory *dir = new Directory();
+    dir->FetchFrom(dirFile);
+    dir->Remove(name);
+    dir->WriteBack(dirFile);
+    delete dir;
+    delete dirFile;
+}
+
+/// Delete the file with header `sector` if it was removed while open and
+/// this was its last `OpenFile`.
+void
+FileSystem::Close(int sector)
+{
+    openFiles->AcquireListLock();
+    if (openFiles->CloseOpenFile(sector)) {
+        DEBUG('f', "Deleting file at sector %d, removed while open\n",
+              sector);
+        DeleteFromDisk(sector);
+    }
+    openFiles->ReleaseListLock();
+}
+
 bool
 FileSystem::DeleteFromDisk(int sector) 
 {
@@ -393,16 +425,12 @@ FileSystem::DeleteFromDisk(int sector)
     freeMapLock->Acquire();
     fileH->FetchFrom(sector);
 
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
-
     fileH->Deallocate(freeMap);  // Remove data blocks.
     freeMap->Clear(sector);      // Remove header block.
 
-    freeMap->WriteBack(freeMapFile);  // Flush to disk.
+    freeMap->WriteBackDirty(freeMapFile);  // Flush to disk.
     freeMapLock->Release();
     delete fileH;
-    delete freeMap;
     return true;
 }
 
@@ -493,6 +521,12 @@ CheckSector(unsigned sector, Bitmap *shadowMap)
                          "sector number already used.");
 }
 
+/// Check a file header, and the tables of the second level of indirection
+/// it points to, if the file needs them.
+///
+/// Such a file counts the sectors of its tables in `numSectors`, but its
+/// own table only lists the tables; each of them is the header of a piece
+/// of `MAX_FILE_SIZE` bytes, the last one of what is left.
 static bool
 CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
 {
@@ -502,14 +536,51 @@ CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
 
     DEBUG('f', "Checking file header %u.  File size: %u bytes, number of sectors: %u.\n",
           num, rh->numBytes, rh->numSectors);
-    error |= CheckForError(rh->numSectors >= DivRoundUp(rh->numBytes,
-                                                        SECTOR_SIZE),
+    if (rh->numBytes <= MAX_FILE_SIZE) {
+        error |= CheckForError(rh->numSectors >= DivRoundUp(rh->numBytes,
+                                                            SECTOR_SIZE),
+                               "sector count not compatible with file size.");
+        if (CheckForError(rh->numSectors <= NUM_DIRECT,
+                          "too many blocks.")) {
+            return true;
+        }
+        for (unsigned i = 0; i < rh->numSectors; i++) {
+            unsigned s = rh->dataSectors[i];
+            error |= CheckSector(s, shadowMap);
+        }
+        return error;
+    }
+
+    if (CheckForError(rh->numBytes <= INDIR_MAX_FILE_SIZE,
+                      "file too large.")) {
+        return true;
+    }
+    unsigned dataSectors = DivRoundUp(rh->numBytes, SECTOR_SIZE);
+    unsigned tables = DivRoundUp(dataSectors, NUM_DIRECT);
+    error |= CheckForError(rh->numSectors == dataSectors + tables,
                            "sector count not compatible with file size.");
-    error |= CheckForError(rh->numSectors < NUM_DIRECT,
-                           "too many blocks.");
-    for (unsigned i = 0; i < rh->numSectors; i++) {
+
+    unsigned remainingBytes = rh->numBytes;
+    for (unsigned i = 0; i < tables; i++) {
         unsigned s = rh->dataSectors[i];
+        unsigned tableBytes = remainingBytes < MAX_FILE_SIZE ? remainingBytes
+                                                             : MAX_FILE_SIZE;
+        remainingBytes -= tableBytes;
+
         error |= CheckSector(s, shadowMap);
+        if (s >= NUM_SECTORS) {
+            continue;
+        }
+        RawFileHeader table;
+        sectorCache->ReadSector(s, (char *) &table);
+        if (CheckForError(table.numBytes == tableBytes,
+                          "table size not compatible with file size.")) {
+            error = true;
+            if (table.numBytes > MAX_FILE_SIZE) {
+                continue;  // Its sectors cannot be trusted.
+            }
+        }
+        error |= CheckFileHeader(&table, s, shadowMap);
     }
     return error;
 }
@@ -614,8 +685,8 @@ FileSystem::Check()
     error |= CheckFileHeader(dirRH, DIRECTORY_SECTOR, shadowMap);
     delete dirH;
 
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
+    Bitmap *diskMap = new Bitmap(NUM_SECTORS);
+    diskMap->FetchFrom(freeMapFile);
     Directory *dir = new Directory();
     const RawDirectory *rdir = dir->GetRaw();
     dir->FetchFrom(directoryFile);
@@ -624,9 +695,10 @@ FileSystem::Check()
 
     // The two bitmaps should match.
     DEBUG('f', "Checking bitmap consistency.\n");
-    error |= CheckBitmaps(freeMap, shadowMap);
+    error |= CheckBitmaps(diskMap, shadowMap);
+    error |= CheckBitmaps(freeMap, diskMap);  // Nothing left unwritten.
     delete shadowMap;
-    delete freeMap;
+    delete diskMap;
 
     DEBUG('f', error ? "Filesystem check failed.\n"
                      : "Filesystem check succeeded.\n");
@@ -645,7 +717,6 @@ FileSystem::Print()
 {
     FileHeader *bitH    = new FileHeader;
     FileHeader *dirH    = new FileHeader;
-    Bitmap     *freeMap = new Bitmap(NUM_SECTORS);
     Directory  *dir     = new Directory();
 
     printf("--------------------------------\n");
@@ -657,7 +728,6 @@ FileSystem::Print()
     dirH->Print("Directory");
 
     printf("--------------------------------\n");
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
     printf("--------------------------------\n");
@@ -667,7 +737,6 @@ FileSystem::Print()
 
     delete bitH;
     delete dirH;
-    delete freeMap;
     delete dir;
 }
 
@@ -675,29 +744,155 @@ Bitmap *
 FileSystem::AcquireFreeMap()
 {
     freeMapLock->Acquire();
-
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
-
     return freeMap;
 }
 
 Bitmap*
 FileSystem::GetCurrentFreeMap()
 {
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
-
     return freeMap;
 }
 
-/// Marks the end of the freeMap usage. The lock is released, the
-/// memory is freed and the changes are saved to disk.
+/// Marks the end of the freeMap usage.  The words of the map that changed
+/// are saved to disk, and the lock is released.
 void
 FileSystem::ReleaseFreeMap(Bitmap *freeMap_)
 {
-    freeMap_->WriteBack(freeMapFile);
-    delete freeMap_;
+    ASSERT(freeMap_ == freeMap);
 
+    freeMap->WriteBackDirty(freeMapFile);
     freeMapLock -> Release();
-}
\ No newline at end of file
+}
+
+void
+FileSystem::PrintFragmentation()
+{
+    FragmentationTotals totals = { 0, 0, 0, 0, 0 };
+    printf("Fragmentation report:\n");
+    WalkFiles(DIRECTORY_SECTOR, "", false, &totals);
+    printf("Files: %u, data sectors %u, extents %u (%.2f per file),"
+           " %u fragmented\n", totals.files, totals.sectors, totals.extents,
+           totals.files == 0 ? 0.0 : (double) totals.extents / totals.files,
+           totals.fragmented);
+
+    unsigned freeSectors = 0, freeExtents = 0, largest = 0, run = 0;
+    for (unsigned i = 0; i < NUM_SECTORS; i++) {
+        if (freeMap->Test(i)) {
+            run = 0;
+            continue;
+        }
+        freeSectors++;
+        if (run++ == 0) {
+            freeExtents++;
+        }
+        if (run > largest) {
+            largest = run;
+        }
+    }
+    printf("Free space: %u sectors in %u extents, largest %u\n",
+           freeSectors, freeExtents, largest);
+}
+
+void
+FileSystem::Defragment()
+{
+    FragmentationTotals totals = { 0, 0, 0, 0, 0 };
+    freeMapLock->Acquire();
+    WalkFiles(DIRECTORY_SECTOR, "", true, &totals);
+    freeMap->WriteBackDirty(freeMapFile);
+    freeMapLock->Release();
+
+    // The root directory may have moved.
+    delete directoryFile;
+    directoryFile = new OpenFile(DIRECTORY_SECTOR);
+    printf("Defragmented %u of %u files.\n", totals.moved, totals.files);
+}
+
+/// A directory is defragmented before its entries are read, and the
+/// bitmap file is left alone, since it is kept open.
+void
+FileSystem::WalkFiles(unsigned dirSector, const std::string &path,
+                      bool defragment, FragmentationTotals *totals)
+{
+    ASSERT(totals != nullptr);
+
+    if (dirSector == DIRECTORY_SECTOR) {
+        FileHeader *h = new FileHeader;
+        h->FetchFrom(dirSector);
+        if (defragment && h->CountExtents() > 1) {
+            Relocate(dirSector);
+            totals->moved++;
+        }
+        delete h;
+    }
+
+    OpenFile *dirFile = new OpenFile(dirSector);
+    Directory *dir = new Directory();
+    dir->FetchFrom(dirFile);
+    const RawDirectory *raw = dir->GetRaw();
+    for (unsigned i = 0; i < raw->tableSize; i++) {
+        const DirectoryEntry *e = &raw->table[i];
+        if (!e->inUse) {
+            continue;
+        }
+        std::string name = path + "/" + e->name;
+
+        FileHeader *h = new FileHeader;
+        h->FetchFrom(e->sector);
+        if (defragment && h->CountExtents() > 1) {
+            Relocate(e->sector);
+            totals->moved++;
+            h->FetchFrom(e->sector);
+        }
+        unsigned sectors = DivRoundUp(h->FileLength(), SECTOR_SIZE);
+        unsigned extents = h->CountExtents();
+        delete h;
+
+        if (!defragment) {
+            printf("    %s: %u sectors, %u extent%s\n", name.c_str(),
+                   sectors, extents, extents == 1 ? "" : "s");
+        }
+        totals->files++;
+        totals->sectors += sectors;
+        totals->extents += extents;
+        if (extents > 1) {
+            totals->fragmented++;
+        }
+        if (e->isDir) {
+            WalkFiles(e->sector, name, defragment, totals);
+        }
+    }
+    delete dir;
+    delete dirFile;
+}
+
+/// The data is read into memory, its sectors are freed, and it is written
+/// back to a single run of free sectors following the header, if there is
+/// one.  Holds `freeMapLock`.
+void
+FileSystem::Relocate(unsigned sector)
+{
+    FileHeader *h = new FileHeader;
+    h->FetchFrom(sector);
+    unsigned length = h->FileLength();
+    unsigned numSectors = DivRoundUp(length, SECTOR_SIZE);
+    unsigned allSectors = h->GetRaw()->numSectors;  // Tables too.
+    char *data = new char [numSectors * SECTOR_SIZE];
+    for (unsigned i = 0; i < numSectors; i++) {
+        sectorCache->ReadSector(h->ByteToSector(i * SECTOR_SIZE),
+                                data + i * SECTOR_SIZE);
+    }
+    h->Deallocate(freeMap);
+    delete h;
+
+    int goal = freeMap->FindRun(allSectors, sector + 1);
+    h = new FileHeader;
+    ASSERT(h->Allocate(freeMap, length, goal == -1 ? sector + 1 : goal));
+    for (unsigned i = 0; i < numSectors; i++) {
+        sectorCache->WriteSector(h->ByteToSector(i * SECTOR_SIZE),
+                                 data + i * SECTOR_SIZE);
+    }
+    h->WriteBack(sector);
+    delete h;
+    delete [] data;
+}
@@ -130,6 +130,10 @@ public:
     /// Delete a file (UNIX `unlink`).
     bool Remove(const char *name);
 
+    /// Called when an `OpenFile` returned by `Open` for the file with
+    /// header `sector` is closed.
+    void Close(int sector);
+
     /// List all the files in the file system.
     void List();
 
@@ -141,26 +145,43 @@ public:
 
     // Returns the bitmap of free sectors on the disk granting reading and
     /// writing exclusivity.
+    ///
+    /// The bitmap stays in memory while Nachos runs, so this reads nothing
+    /// from disk.
     Bitmap* AcquireFreeMap();
 
     /// Returns the current value of the freeMap pointer. No exclusive access
     /// is guaranteed.
     Bitmap* GetCurrentFreeMap();
 
-    /// Marks the end of the freeMap usage. The lock is released, the
-    /// memory is freed and the changes are saved to disk.
+    /// Marks the end of the freeMap usage. The lock is released, and the
+    /// changes are saved to disk.
     void ReleaseFreeMap(Bitmap *freeMap);
 
     DirectoryEntry FindPath(FilePath* path);
 
     void firstThreadStart();
 
+    /// Print how many extents hold the data of each file, and how the free
+    /// space is split.
+    void PrintFragmentation();
+
+    /// Move the data of every fragmented file into as few extents as
+    /// possible, next to its header.  Meant to be run offline, when no
+    /// other thread uses the file system.
+    void Defragment();
+
 private:
     OpenFile *freeMapFile;  ///< Bit map of free disk blocks, represented as a
                             ///< file.
     OpenFile *directoryFile;  ///< “Root” directory -- list of file names,
                               ///< represented as a file.
 
+    /// Bit map of free disk blocks, kept in memory.  Changes are made
+    /// holding `freeMapLock`, and written to `freeMapFile` before it is
+    /// released.
+    Bitmap *freeMap;
+
     OpenFileList* openFiles;
 
     DirectoryList* dirList;
@@ -170,7 +191,27 @@ private:
     /// and assumes the lock from the OpenFileList is previously acquired.
     bool DeleteFromDisk(int sector);
 
+    /// Take the entry `name` out of the directory with header `dirSector`.
+    void RemoveEntry(int dirSector, const char *name);
+
     Lock *freeMapLock;
+
+    struct FragmentationTotals {
+        unsigned files;
+        unsigned sectors;
+        unsigned extents;
+        unsigned fragmented;  ///< Files in more than one extent.
+        unsigned moved;
+    };
+
+    /// Visit the files under the directory with header `dirSector`, named
+    /// `path`, adding them to `totals`, and defragmenting them if
+    /// `defragment`.
+    void WalkFiles(unsigned dirSector, const std::string &path,
+                   bool defragment, FragmentationTotals *totals);
+
+    /// Move the data of the file with header `sector` to a new place.
+    void Relocate(unsigned sector);
 };
 
 #endif
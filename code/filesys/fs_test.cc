@@ -4,11 +4,16 @@
 ///
 /// Copy
 ///     Copy a file from UNIX to Nachos.
+/// CopySectors
+///     Copy a file from UNIX to Nachos, in whole sectors.
 /// Print
 ///     Cat the contents of a Nachos file.
 /// Perftest
 ///     A stress test for the Nachos file system read and write a really
 ///     really large file in tiny chunks (will not work on baseline system!)
+/// DiskSchedulingTest
+///     Random reads from several threads at once, timed under every disk
+///     scheduling policy.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -23,6 +28,7 @@
 #include "threads/thread.hh"
 #include "threads/system.hh"
 
+#include <algorithm>
 #include <stdio.h>
 #include <string.h>
 
@@ -30,9 +36,14 @@
 static const unsigned TRANSFER_SIZE = 10;  // Make it small, just to be
                                            // difficult.
 
-/// Copy the contents of the UNIX file `from` to the Nachos file `to`.
-void
-Copy(const char *from, const char *to)
+/// `CopySectors` moves whole sectors at a time instead, so that `WriteAt`
+/// sends them straight to disk.
+static const unsigned COPY_SIZE = 8 * SECTOR_SIZE;
+
+/// Copy the contents of the UNIX file `from` to the Nachos file `to`, in
+/// chunks of `chunkSize` bytes.
+static void
+CopyInChunks(const char *from, const char *to, unsigned chunkSize)
 {
     ASSERT(from != nullptr);
     ASSERT(to != nullptr);
@@ -62,11 +73,11 @@ Copy(const char *from, const char *to)
     OpenFile *openFile = fileSystem->Open(to);
     ASSERT(openFile != nullptr);
 
-    // Copy the data in `TRANSFER_SIZE` chunks.
-    char *buffer = new char [TRANSFER_SIZE];
+    // Copy the data in `chunkSize` chunks.
+    char *buffer = new char [chunkSize];
     int amountRead;
     while ((amountRead = fread(buffer, sizeof(char),
-                               TRANSFER_SIZE, fp)) > 0)
+                               chunkSize, fp)) > 0)
         openFile->Write(buffer, amountRead);
     delete [] buffer;
 
@@ -75,6 +86,20 @@ Copy(const char *from, const char *to)
     fclose(fp);
 }
 
+/// Copy the contents of the UNIX file `from` to the Nachos file `to`.
+void
+Copy(const char *from, const char *to)
+{
+    CopyInChunks(from, to, TRANSFER_SIZE);
+}
+
+/// Like `Copy`, but a few whole sectors at a time.
+void
+CopySectors(const char *from, const char *to)
+{
+    CopyInChunks(from, to, COPY_SIZE);
+}
+
 /// Print the contents of the Nachos file `name`.
 void
 Print(const char *name)
@@ -182,3 +207,122 @@ PerformanceTest()
     }
     stats->Print();
 }
+
+/// Disk scheduling benchmark.
+///
+/// `BENCH_THREADS` threads read random spans of one to `BENCH_MAX_SECTORS`
+/// sectors from files of their own, spread over the disk, so that requests
+/// from different threads wait for the disk together.  The latency of every
+/// read is taken in ticks, and the mean and tail are printed per policy.
+/// The files are much larger than the sector cache, so most reads miss.
+///
+/// The files are removed at the end; they take up more than half of the
+/// disk.
+
+static const unsigned BENCH_THREADS = 8;
+static const unsigned BENCH_FILE_SIZE = 2 * SECTORS_PER_TRACK * SECTOR_SIZE;
+static const unsigned BENCH_MAX_SECTORS = 4;
+static const unsigned BENCH_READS = 100;  ///< Per thread and policy.
+
+struct BenchWorker {
+    OpenFile *file;
+    unsigned long *latencies;  ///< Of each of its reads, in ticks.
+};
+
+static void
+BenchRead(void *arg)
+{
+    ASSERT(arg != nullptr);
+    BenchWorker *worker = (BenchWorker *) arg;
+
+    char buffer[BENCH_MAX_SECTORS * SECTOR_SIZE];
+    unsigned numSectors = BENCH_FILE_SIZE / SECTOR_SIZE;
+    for (unsigned i = 0; i < BENCH_READS; i++) {
+        unsigned count = 1 + SystemDep::Random() % BENCH_MAX_SECTORS;
+        unsigned first = SystemDep::Random() % (numSectors - count + 1);
+        unsigned long start = stats->totalTicks;
+        worker->file->ReadAt(buffer, count * SECTOR_SIZE,
+                             first * SECTOR_SIZE);
+        worker->latencies[i] = stats->totalTicks - start;
+    }
+}
+
+/// Return the latency below which `percent` percent of the sorted
+/// `latencies` fall.
+static unsigned long
+Percentile(const unsigned long *latencies, unsigned count, unsigned percent)
+{
+    unsigned rank = (count * percent + 99) / 100;
+    return latencies[rank == 0 ? 0 : rank - 1];
+}
+
+void
+DiskSchedulingTest()
+{
+    printf("Disk scheduling test: %u threads, %u random reads each of up"
+           " to %u sectors\n", BENCH_THREADS, BENCH_READS, BENCH_MAX_SECTORS);
+
+    char names[BENCH_THREADS][FILE_NAME_MAX_LEN + 1];
+    BenchWorker workers[BENCH_THREADS];
+    unsigned created = 0;
+    for (; created < BENCH_THREADS; created++) {
+        snprintf(names[created], sizeof names[created], "Bench%u", created);
+        fileSystem->Create(names[created], BENCH_FILE_SIZE);
+          // Fails if an interrupted run left the file behind, which is
+          // fine.
+        OpenFile *file = fileSystem->Open(names[created]);
+        if (file == nullptr) {
+            fprintf(stderr, "Scheduling test: cannot create %s\n",
+                    names[created]);
+            break;
+        }
+        workers[created].file = file;
+        workers[created].latencies = new unsigned long [BENCH_READS];
+    }
+
+    unsigned long *all = new unsigned long [created * BENCH_READS];
+    DiskSchedulingPolicy oldPolicy = synchDisk->GetPolicy();
+    for (unsigned p = 0; p < NUM_DISK_POLICIES && created > 0; p++) {
+        DiskSchedulingPolicy policy = (DiskSchedulingPolicy) p;
+        synchDisk->SetPolicy(policy);
+
+        Thread *threads[BENCH_THREADS];
+        for (unsigned i = 0; i < created; i++) {
+            threads[i] = new Thread(names[i], true, 0);
+            threads[i]->Fork(BenchRead, &workers[i]);
+        }
+        for (unsigned i = 0; i < created; i++) {
+#ifdef USER_PROGRAM
+            // Nothing else takes the thread out, and it would keep Nachos
+            // from halting.
+            int spaceId = threads[i]->spaceId;
+            threads[i]->Join();
+            runningThreads->Remove(spaceId);
+#else
+            threads[i]->Join();
+#endif
+        }
+
+        unsigned n = 0;
+        unsigned long total = 0;
+        for (unsigned i = 0; i < created; i++) {
+            for (unsigned j = 0; j < BENCH_READS; j++) {
+                all[n++] = workers[i].latencies[j];
+                total += workers[i].latencies[j];
+            }
+        }
+        std::sort(all, all + n);
+        printf("%-6s mean %8.1f, p50 %6lu, p95 %6lu, p99 %6lu, max %6lu"
+               " ticks\n", SynchDisk::GetPolicyName(policy),
+               (double) total / n, Percentile(all, n, 50),
+               Percentile(all, n, 95), Percentile(all, n, 99), all[n - 1]);
+    }
+    synchDisk->SetPolicy(oldPolicy);
+
+    delete [] all;
+    for (unsigned i = 0; i < created; i++) {
+        delete workers[i].file;
+        delete [] workers[i].latencies;
+        fileSystem->Remove(names[i]);
+    }
+}
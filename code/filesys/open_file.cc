@@ -31,12 +31,18 @@ OpenFile::OpenFile(int sector, ReadWriteController* rw, FilePath path_)
     seekPosition = 0;
     diskSector = sector;
     path = path_;
+    expectedRead = 0;
+    readAheadWindow = 0;
+    readAheadEnd = 0;
 }
 
 /// Close a Nachos file, de-allocating any in-memory data structures.
 OpenFile::~OpenFile()
 {
     delete hdr;
+    if (accessController != nullptr) {  // Opened through `FileSystem::Open`.
+        fileSystem->Close(diskSector);
+    }
 }
 
 /// Change the current location within the open file -- the point at which
@@ -91,11 +97,12 @@ OpenFile::Write(const char *into, unsigned numBytes)
 ///
 /// There is no guarantee the request starts or ends on an even disk sector
 /// boundary; however the disk only knows how to read/write a whole disk
-/// sector at a time.  Thus:
+/// sector at a time.  Sectors wholly covered by the request are transferred
+/// straight between the disk and the caller's buffer.  Thus:
 ///
 /// For ReadAt:
-///     We read in all of the full or partial sectors that are part of the
-///     request, but we only copy the part we are interested in.
+///     We read a partial first or last sector into a sector buffer, and
+///     only copy the part we are interested in.
 /// For WriteAt:
 ///     We must first read in any sectors that will be partially written, so
 ///     that we do not overwrite the unmodified portion.  We then copy in the
@@ -108,6 +115,80 @@ OpenFile::Write(const char *into, unsigned numBytes)
 /// * `position` is the offset within the file of the first byte to be
 ///   read/written.
 
+/// Maximum number of sectors sent to the disk in one sequence.
+static const unsigned MAX_SECTORS_PER_TRANSFER = SECTORS_PER_TRACK;
+
+void
+OpenFile::TransferSectors(char *buffer, unsigned numBytes, unsigned position,
+                          char *head, char *tail, bool writing)
+{
+    unsigned firstSector = DivRoundDown(position, SECTOR_SIZE);
+    unsigned lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
+
+    int sectors[MAX_SECTORS_PER_TRANSFER];
+    char *data[MAX_SECTORS_PER_TRANSFER];
+    unsigned count = 0;
+    for (unsigned i = firstSector; i <= lastSector; i++) {
+        unsigned start = i * SECTOR_SIZE;
+        sectors[count] = hdr->ByteToSector(start);
+        if (start < position) {
+            data[count] = head;
+        } else if (start + SECTOR_SIZE > position + numBytes) {
+            data[count] = tail;
+        } else {
+            data[count] = &buffer[start - position];
+        }
+        count++;
+        if (count == MAX_SECTORS_PER_TRANSFER || i == lastSector) {
+            if (writing) {
+                sectorCache->WriteSectors(sectors, data, count);
+            } else {
+                sectorCache->ReadSectors(sectors, data, count);
+            }
+            count = 0;
+        }
+    }
+}
+
+unsigned OpenFile::readAheadLimit = 16;
+
+void
+OpenFile::ReadAhead(unsigned position, unsigned numBytes)
+{
+    if (position != expectedRead) {
+        DEBUG('f', "Random read at %u, stopping read-ahead.\n", position);
+        readAheadWindow = 0;
+        readAheadEnd = 0;
+        expectedRead = position + numBytes;
+        return;
+    }
+    expectedRead = position + numBytes;
+    readAheadWindow = readAheadWindow == 0 ? 2 : 2 * readAheadWindow;
+    if (readAheadWindow > readAheadLimit) {
+        readAheadWindow = readAheadLimit;
+    }
+
+    unsigned next = DivRoundDown(expectedRead - 1, SECTOR_SIZE) + 1;
+    unsigned first = next > readAheadEnd ? next : readAheadEnd;
+    unsigned last = next + readAheadWindow;
+    unsigned fileSectors = DivRoundUp(hdr->FileLength(), SECTOR_SIZE);
+    if (last > fileSectors) {
+        last = fileSectors;
+    }
+    if (first >= last) {
+        return;
+    }
+
+    int sectors[MAX_SECTORS_PER_TRANSFER];
+    unsigned count = 0;
+    for (unsigned i = first; i < last && count < MAX_SECTORS_PER_TRANSFER;
+           i++) {
+        sectors[count++] = hdr->ByteToSector(i * SECTOR_SIZE);
+    }
+    sectorCache->Prefetch(sectors, count);
+    readAheadEnd = first + count;
+}
+
 int
 OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
 {
@@ -119,8 +200,6 @@ OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
         accessController -> AcquireRead();
     }
     unsigned fileLength = hdr->FileLength();
-    unsigned firstSector, lastSector, numSectors;
-    char *buf;
 
     if (position >= fileLength) {
         if(accessController != nullptr)
@@ -133,25 +212,27 @@ OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
     DEBUG('f', "Reading %u bytes at %u, from file of length %u.\n",
           numBytes, position, fileLength);
 
-    firstSector = DivRoundDown(position, SECTOR_SIZE);
-    lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-    numSectors = 1 + lastSector - firstSector;
-
-    // Read in all the full and partial sectors that we need.
-    buf = new char [numSectors * SECTOR_SIZE];
-    for (unsigned i = firstSector; i <= lastSector; i++) {
-        synchDisk->ReadSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                              &buf[(i - firstSector) * SECTOR_SIZE]);
+    char head[SECTOR_SIZE], tail[SECTOR_SIZE];
+    TransferSectors(into, numBytes, position, head, tail, false);
+    ReadAhead(position, numBytes);
+
+    // Copy the part we want of partial sectors.
+    unsigned headOffset = position % SECTOR_SIZE;
+    unsigned end = position + numBytes;
+    unsigned tailStart = end - end % SECTOR_SIZE;
+    if (headOffset != 0) {
+        unsigned headBytes = SECTOR_SIZE - headOffset;
+        memcpy(into, &head[headOffset],
+               numBytes < headBytes ? numBytes : headBytes);
+    }
+    if (end % SECTOR_SIZE != 0 && tailStart >= position) {
+        memcpy(&into[tailStart - position], tail, end - tailStart);
     }
-
-    // Copy the part we want.
-    memcpy(into, &buf[position - firstSector * SECTOR_SIZE], numBytes);
 
     if (accessController != nullptr) {
         DEBUG('f', "Releasing reader access controller lock\n");
         accessController->ReleaseRead();
     }
-    delete [] buf;
     return numBytes;
 }
 
@@ -167,9 +248,6 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     }
 
     unsigned fileLength = hdr->FileLength();
-    unsigned firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
 
     if (position > fileLength) {
         if (accessController != nullptr) {
@@ -189,7 +267,7 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
         else
             freeMap = fileSystem -> AcquireFreeMap();
 
-        if (not hdr -> Extend(freeMap, extendSize)){
+        if (not hdr -> Extend(freeMap, extendSize, diskSector + 1)){
             if(accessController != nullptr){
                 accessController -> ReleaseWrite();
                 fileSystem -> ReleaseFreeMap(freeMap);
@@ -210,39 +288,45 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     DEBUG('f', "Writing %u bytes at %u, from file of length %u.\n",
           numBytes, position, fileLength);
 
-    firstSector = DivRoundDown(position, SECTOR_SIZE);
-    lastSector  = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-    numSectors  = 1 + lastSector - firstSector;
-
-    buf = new char [numSectors * SECTOR_SIZE];
-
-    firstAligned = position == firstSector * SECTOR_SIZE;
-    lastAligned  = position + numBytes == (lastSector + 1) * SECTOR_SIZE;
-
-    // Read in first and last sector, if they are to be partially modified.
-    if (!firstAligned) {
-        ReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
+    char head[SECTOR_SIZE], tail[SECTOR_SIZE];
+    unsigned headOffset = position % SECTOR_SIZE;
+    unsigned end = position + numBytes;
+    unsigned tailStart = end - end % SECTOR_SIZE;
+    bool partialHead = headOffset != 0;
+    bool partialTail = end % SECTOR_SIZE != 0 && tailStart >= position;
+
+    // Read in first and last sector, if they are to be partially modified,
+    // and copy in the bytes we want to change.
+    int sectors[2];
+    char *data[2];
+    unsigned count = 0;
+    if (partialHead) {
+        sectors[count] = hdr->ByteToSector(position - headOffset);
+        data[count++] = head;
     }
-    if (!lastAligned && (firstSector != lastSector || firstAligned)) {
-        ReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
-               SECTOR_SIZE, lastSector * SECTOR_SIZE);
+    if (partialTail) {
+        sectors[count] = hdr->ByteToSector(tailStart);
+        data[count++] = tail;
+    }
+    if (count > 0) {
+        sectorCache->ReadSectors(sectors, data, count);
+    }
+    if (partialHead) {
+        unsigned headBytes = SECTOR_SIZE - headOffset;
+        memcpy(&head[headOffset], from,
+               numBytes < headBytes ? numBytes : headBytes);
+    }
+    if (partialTail) {
+        memcpy(tail, &from[tailStart - position], end - tailStart);
     }
-
-    // Copy in the bytes we want to change.
-    memcpy(&buf[position - firstSector * SECTOR_SIZE], from, numBytes);
 
     // Write modified sectors back.
-    for (unsigned i = firstSector; i <= lastSector; i++) {
-        synchDisk->WriteSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                               &buf[(i - firstSector) * SECTOR_SIZE]);
-    }
+    TransferSectors((char *) from, numBytes, position, head, tail, true);
 
     if (accessController != nullptr) {
         DEBUG('f', "Realising writer access controller lock\n");
         accessController->ReleaseWrite();
     }
-    
-    delete [] buf;
     return numBytes;
 }
 
@@ -80,6 +80,13 @@ public:
         return SystemDep::Tell(file);
     }
 
+    /// Return a number that identifies the file while it exists, standing
+    /// in for the sector of its header in the real file system.
+    unsigned long GetFileId() const
+    {
+        return SystemDep::FileId(file);
+    }
+
 private:
     int file;
     unsigned currentOffset;
@@ -120,16 +127,49 @@ public:
 
     int GetSector();
 
+    /// Return a number that identifies the file while it exists: the sector
+    /// of its header.
+    unsigned long GetFileId()
+    {
+        return GetSector();
+    }
+
     FileHeader* GetFileHeader();
 
     FilePath GetPath();
 
+    /// Maximum number of sectors read ahead of sequential reads.  Zero
+    /// disables read-ahead.
+    static unsigned readAheadLimit;
+
   private:
+    /// Read/write the sectors holding `numBytes` bytes at `position`:
+    /// sectors wholly covered by the request go straight from/into
+    /// `buffer`, and a partial first or last one from/into `head` or
+    /// `tail`, each `SECTOR_SIZE` bytes long.
+    void TransferSectors(char *buffer, unsigned numBytes, unsigned position,
+                         char *head, char *tail, bool writing);
+
+    /// Read sectors ahead, after a read of `numBytes` at `position`, if
+    /// reads are sequential.
+    void ReadAhead(unsigned position, unsigned numBytes);
+
     ReadWriteController *accessController;
     FileHeader *hdr; ///< Header for this file.
     unsigned seekPosition;  ///< Current position within the file.
     int diskSector; // < Sector of the disk where the file is
     FilePath path;
+
+    /// Position the next read starts at, if reads are sequential.
+    unsigned expectedRead;
+
+    /// Number of sectors read ahead of the last read; it doubles with each
+    /// sequential read, up to `readAheadLimit`, and drops to zero on a
+    /// random one.
+    unsigned readAheadWindow;
+
+    /// First sector of the file that was not read ahead yet.
+    unsigned readAheadEnd;
 };
 
 #endif
@@ -52,17 +52,21 @@ OpenFileList::AddOpenFile(int sector){
 }
 
 
-void
+bool
 OpenFileList::CloseOpenFile(int sector){
 
+	bool mustDelete = false;
 	FileMetaData* node = FindOpenFile(sector);
 	if(node != nullptr){
 		if(node -> openInstances > 1)
 			node -> openInstances--;
-		else
+		else{
+			mustDelete = node -> pendingRemove;
 			DeleteNode(node);
+		}
 	}
 
+	return mustDelete;
 }
 
 
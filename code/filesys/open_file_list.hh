@@ -34,7 +34,9 @@ class OpenFileList {
 
         // Decreases the openInstances by 1. If no open instances remain,
         // the file is removed from the list.
-        void CloseOpenFile(int sector);
+        // Returns true if the file is pending removal and this was its
+        // last open instance, so it must now be deleted from disk.
+        bool CloseOpenFile(int sector);
 
         // Returns true if the file is currently open, in which case
         // SetUpRemoval sets pendingRemove to true atomically.
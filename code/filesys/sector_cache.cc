@@ -0,0 +1,426 @@
+/// Routines to cache disk sectors.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "sector_cache.hh"
+#include "threads/system.hh"
+
+#include <algorithm>
+#include <string.h>
+
+
+/// Maximum number of sectors handled at once by `ReadSectors`.
+static const unsigned MAX_BATCH = SECTORS_PER_TRACK;
+
+static void
+ReadAheadThread(void *cache)
+{
+    ((SectorCache *) cache)->ReadAhead();
+}
+
+SectorCache::SectorCache(SynchDisk *disk_, unsigned size_)
+{
+    ASSERT(disk_ != nullptr);
+    ASSERT(size_ > 0);
+
+    disk = disk_;
+    size = size_;
+    entries = new Entry[size];
+    hashNext = new int[size];
+    buckets = new int[2 * size];
+    for (unsigned i = 0; i < 2 * size; i++) {
+        buckets[i] = -1;
+    }
+    lruNext = new unsigned[size + 1];
+    lruPrev = new unsigned[size + 1];
+    for (unsigned i = 0; i <= size; i++) {
+        lruNext[i] = lruPrev[i] = i;
+    }
+    for (unsigned i = 0; i < size; i++) {
+        entries[i].sector = -1;
+        entries[i].dirty = false;
+        entries[i].pins = 0;
+        entries[i].readAhead = false;
+        entries[i].access = new ReadWriteController;
+        Touch(i);
+    }
+    flushSectors = new int[size];
+    flushData = new const char *[size];
+    flushEntries = new unsigned[size];
+    flushing = false;
+    lastFlush = 0;
+
+    readAheadStart = readAheadCount = 0;
+    readAheadReady = new Semaphore("read ahead", 0);
+    readAheadThread = new Thread("read ahead", false, 0, true);
+    readAheadThread->Fork(ReadAheadThread, this);
+}
+
+SectorCache::~SectorCache()
+{
+    // Nothing should be dirty after `FlushAtHalt`, unless the cache is
+    // deleted without a halt.
+    FlushAtHalt();
+    for (unsigned i = 0; i < size; i++) {
+        delete entries[i].access;
+    }
+    delete [] entries;
+    delete [] hashNext;
+    delete [] buckets;
+    delete [] lruNext;
+    delete [] lruPrev;
+    delete [] flushSectors;
+    delete [] flushData;
+    delete [] flushEntries;
+    // Nachos is halting, so the read-ahead thread will never run again;
+    // it goes before the semaphore it may be blocked on.
+    delete readAheadThread;
+    delete readAheadReady;
+}
+
+unsigned
+SectorCache::Bucket(int sector) const
+{
+    return (unsigned) sector % (2 * size);
+}
+
+int
+SectorCache::Find(int sector) const
+{
+    for (int i = buckets[Bucket(sector)]; i != -1; i = hashNext[i]) {
+        if (entries[i].sector == sector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+SectorCache::Unhash(unsigned which)
+{
+    int *link = &buckets[Bucket(entries[which].sector)];
+    while (*link != (int) which) {
+        ASSERT(*link != -1);
+        link = &hashNext[*link];
+    }
+    *link = hashNext[which];
+}
+
+void
+SectorCache::Touch(unsigned which)
+{
+    if (lruNext[which] != which) {  // Unlink it, unless it is new.
+        lruNext[lruPrev[which]] = lruNext[which];
+        lruPrev[lruNext[which]] = lruPrev[which];
+    }
+    unsigned last = lruPrev[size];
+    lruNext[which] = size;
+    lruPrev[which] = last;
+    lruNext[last] = which;
+    lruPrev[size] = which;
+}
+
+void
+SectorCache::WriteBack(unsigned which)
+{
+    Entry *e = &entries[which];
+    e->pins++;
+    e->access->AcquireWrite();
+    if (e->dirty) {
+        disk->WriteSector(e->sector, e->data);
+        e->dirty = false;
+        stats->numSectorCacheWriteBacks++;
+    }
+    e->access->ReleaseWrite();
+    e->pins--;
+}
+
+int
+SectorCache::Lookup(int sector, bool *hit)
+{
+    ASSERT(hit != nullptr);
+
+    for (;;) {
+        int found = Find(sector);
+        if (found != -1) {
+            if (entries[found].readAhead) {
+                entries[found].readAhead = false;
+                stats->numSectorsReadAheadUsed++;
+            }
+            entries[found].pins++;
+            Touch(found);
+            *hit = true;
+            return found;
+        }
+
+        unsigned victim = lruNext[size];
+        while (victim != size && entries[victim].pins > 0) {
+            victim = lruNext[victim];
+        }
+        if (victim == size) {
+            return -1;
+        }
+        if (entries[victim].dirty) {
+            // Write it back while it can still be found, and look again,
+            // since the cache may have changed meanwhile.
+            WriteBack(victim);
+            continue;
+        }
+
+        Entry *e = &entries[victim];
+        if (e->sector != -1) {
+            Unhash(victim);
+        }
+        e->sector = sector;
+        e->readAhead = false;
+        hashNext[victim] = buckets[Bucket(sector)];
+        buckets[Bucket(sector)] = victim;
+        e->pins++;
+        e->access->AcquireWrite();  // Nobody holds it, so it does not wait.
+        Touch(victim);
+        *hit = false;
+        return victim;
+    }
+}
+
+void
+SectorCache::ReadSector(int sectorNumber, char *data)
+{
+    ReadSectors(&sectorNumber, &data, 1);
+}
+
+void
+SectorCache::WriteSector(int sectorNumber, const char *data)
+{
+    WriteSectors(&sectorNumber, &data, 1);
+}
+
+/// Sectors are looked up first.  The missing ones are claimed, held
+/// exclusively, and read in one sequence, straight into the caller's buffer
+/// if there is no entry left for them.  Cached ones are copied out last, so
+/// that no entry is held while waiting for another one.
+void
+SectorCache::ReadSectors(const int *sectorNumbers, char *const *data,
+                         unsigned count)
+{
+    ASSERT(sectorNumbers != nullptr);
+    ASSERT(data != nullptr);
+
+    while (count > MAX_BATCH) {
+        ReadSectors(sectorNumbers, data, MAX_BATCH);
+        sectorNumbers += MAX_BATCH;
+        data += MAX_BATCH;
+        count -= MAX_BATCH;
+    }
+
+    int found[MAX_BATCH];
+    bool hits[MAX_BATCH];
+    int missSectors[MAX_BATCH];
+    char *missData[MAX_BATCH];
+    unsigned numMisses = 0;
+    for (unsigned i = 0; i < count; i++) {
+        found[i] = Lookup(sectorNumbers[i], &hits[i]);
+        if (found[i] != -1 && hits[i]) {
+            stats->numSectorCacheHits++;
+            stats->numSectorCacheReadHits++;
+            continue;
+        }
+        stats->numSectorCacheMisses++;
+        missSectors[numMisses] = sectorNumbers[i];
+        missData[numMisses++] = found[i] == -1 ? data[i]
+                                               : entries[found[i]].data;
+    }
+    if (numMisses > 0) {
+        disk->ReadSectors(missSectors, missData, numMisses);
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        if (found[i] != -1 && !hits[i]) {
+            Entry *e = &entries[found[i]];
+            memcpy(data[i], e->data, SECTOR_SIZE);
+            e->access->ReleaseWrite();
+            e->pins--;
+        }
+    }
+    for (unsigned i = 0; i < count; i++) {
+        if (found[i] != -1 && hits[i]) {
+            Entry *e = &entries[found[i]];
+            e->access->AcquireRead();
+            memcpy(data[i], e->data, SECTOR_SIZE);
+            e->access->ReleaseRead();
+            e->pins--;
+        }
+    }
+}
+
+/// Whole sectors are written, so sectors that are not cached need not be
+/// read first.
+void
+SectorCache::WriteSectors(const int *sectorNumbers, const char *const *data,
+                          unsigned count)
+{
+    ASSERT(sectorNumbers != nullptr);
+    ASSERT(data != nullptr);
+
+    for (unsigned i = 0; i < count; i++) {
+        bool hit;
+        int which = Lookup(sectorNumbers[i], &hit);
+        if (which == -1) {
+            stats->numSectorCacheMisses++;
+            disk->WriteSector(sectorNumbers[i], data[i]);
+            continue;
+        }
+        Entry *e = &entries[which];
+        if (hit) {
+            stats->numSectorCacheHits++;
+            e->access->AcquireWrite();
+            if (e->dirty) {
+                stats->numSectorCacheWritesAbsorbed++;
+            }
+        } else {
+            stats->numSectorCacheMisses++;
+        }
+        memcpy(e->data, data[i], SECTOR_SIZE);
+        e->dirty = true;
+        e->access->ReleaseWrite();
+        e->pins--;
+    }
+
+    if (stats->totalTicks - lastFlush >= CACHE_FLUSH_PERIOD) {
+        Flush();
+    }
+}
+
+void
+SectorCache::Flush()
+{
+    if (flushing) {
+        return;  // Another thread is at it.
+    }
+    flushing = true;
+    lastFlush = stats->totalTicks;
+
+    unsigned count = 0;
+    for (unsigned i = 0; i < size; i++) {
+        if (entries[i].dirty && entries[i].pins == 0) {
+            flushEntries[count++] = i;
+        }
+    }
+    std::sort(flushEntries, flushEntries + count,
+              [this](unsigned a, unsigned b) {
+                  return entries[a].sector < entries[b].sector;
+              });
+
+    // Entries in use are left for the next flush.  The others are pinned
+    // before waiting for any of them.
+    for (unsigned i = 0; i < count; i++) {
+        entries[flushEntries[i]].pins++;
+    }
+    unsigned numWrites = 0;
+    for (unsigned i = 0; i < count; i++) {
+        Entry *e = &entries[flushEntries[i]];
+        e->access->AcquireWrite();
+        flushSectors[numWrites] = e->sector;
+        flushData[numWrites++] = e->data;
+    }
+    DEBUG('f', "Flushing %u dirty sectors.\n", numWrites);
+    if (numWrites > 0) {
+        disk->WriteSectors(flushSectors, flushData, numWrites);
+        stats->numSectorCacheWriteBacks += numWrites;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        Entry *e = &entries[flushEntries[i]];
+        e->dirty = false;
+        e->access->ReleaseWrite();
+        e->pins--;
+    }
+    flushing = false;
+}
+
+void
+SectorCache::FlushAtHalt()
+{
+    // Threads cannot wait for the disk any more.
+    for (unsigned i = 0; i < size; i++) {
+        if (entries[i].dirty) {
+            disk->WriteSectorAtHalt(entries[i].sector, entries[i].data);
+            entries[i].dirty = false;
+            stats->numSectorCacheWriteBacks++;
+        }
+    }
+}
+
+void
+SectorCache::Prefetch(const int *sectorNumbers, unsigned count)
+{
+    ASSERT(sectorNumbers != nullptr);
+
+    bool wasEmpty = readAheadCount == 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (readAheadCount == READ_AHEAD_QUEUE_SIZE) {
+            break;
+        }
+        if (Find(sectorNumbers[i]) != -1) {
+            continue;
+        }
+        readAheadQueue[(readAheadStart + readAheadCount)
+                       % READ_AHEAD_QUEUE_SIZE] = sectorNumbers[i];
+        readAheadCount++;
+    }
+    if (wasEmpty && readAheadCount > 0) {
+        readAheadReady->V();
+    }
+}
+
+/// Take the queued sectors in batches, and read the ones that are still not
+/// cached in one sequence of disk requests.
+void
+SectorCache::ReadAhead()
+{
+    for (;;) {
+        readAheadReady->P();
+        while (readAheadCount > 0) {
+            int sectors[MAX_BATCH];
+            char *data[MAX_BATCH];
+            unsigned claimed[MAX_BATCH];
+            unsigned count = 0;
+            while (readAheadCount > 0 && count < MAX_BATCH) {
+                int sector = readAheadQueue[readAheadStart];
+                readAheadStart = (readAheadStart + 1) % READ_AHEAD_QUEUE_SIZE;
+                readAheadCount--;
+                if (Find(sector) != -1) {
+                    continue;
+                }
+                bool hit;
+                int which = Lookup(sector, &hit);
+                if (which == -1) {
+                    break;
+                }
+                if (hit) {  // Brought in while a victim was written back.
+                    entries[which].pins--;
+                    continue;
+                }
+                sectors[count] = sector;
+                data[count] = entries[which].data;
+                claimed[count++] = which;
+            }
+            if (count == 0) {
+                continue;
+            }
+            DEBUG('f', "Reading %u sectors ahead, from sector %d.\n",
+                  count, sectors[0]);
+            disk->ReadSectors(sectors, data, count);
+            stats->numSectorsReadAhead += count;
+            for (unsigned i = 0; i < count; i++) {
+                Entry *e = &entries[claimed[i]];
+                e->readAhead = true;
+                e->access->ReleaseWrite();
+                e->pins--;
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+/// A cache of disk sectors, between the file system and the disk.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_SECTORCACHE__HH
+#define NACHOS_FILESYS_SECTORCACHE__HH
+
+
+#include "synch_disk.hh"
+#include "read_write_controller.hh"
+#include "threads/thread.hh"
+
+
+/// Number of sectors kept in the cache.
+const unsigned NUM_CACHE_SECTORS = 64;
+
+/// Ticks after which a write flushes the dirty sectors of the cache.
+const unsigned long CACHE_FLUSH_PERIOD = 1000000;
+
+/// Number of sectors that can wait to be read ahead.
+const unsigned READ_AHEAD_QUEUE_SIZE = 32;
+
+
+/// Keeps recently used disk sectors in memory, so that hot sectors such as
+/// those of the root directory, the free map and file headers are only read
+/// once, and writes are gathered before going to disk.
+///
+/// Sectors are found through a hash table, and the least recently used one
+/// is replaced when the cache is full.  Written sectors are marked dirty
+/// and only written back when replaced, every `CACHE_FLUSH_PERIOD` ticks,
+/// or when Nachos halts.
+///
+/// Each cached sector has its own controller, so that any number of
+/// threads can read it at once, while filling or writing it is exclusive.
+/// The interface is the one of `SynchDisk`.
+///
+/// Sectors can also be read ahead, by a kernel thread that brings them into
+/// the cache while the threads that asked for them go on.
+class SectorCache {
+public:
+
+    /// Initialize a cache of `size` sectors in front of `disk`.
+    SectorCache(SynchDisk *disk, unsigned size = NUM_CACHE_SECTORS);
+
+    /// Write back the dirty sectors, and de-allocate the cache.  Only to be
+    /// called when Nachos halts.
+    ~SectorCache();
+
+    /// Read/write a disk sector, going to disk only if it is not cached.
+
+    void ReadSector(int sectorNumber, char *data);
+    void WriteSector(int sectorNumber, const char *data);
+
+    /// Read/write `count` sectors, sector `sectorNumbers[i]` from/into
+    /// buffer `data[i]`.  The sectors that are not cached are transferred
+    /// in one sequence of disk requests.
+
+    void ReadSectors(const int *sectorNumbers, char *const *data,
+                     unsigned count);
+    void WriteSectors(const int *sectorNumbers, const char *const *data,
+                      unsigned count);
+
+    /// Write every dirty sector back to disk, in sector order.
+    void Flush();
+
+    /// Write every dirty sector back to disk while Nachos halts, when
+    /// threads can no longer wait for the disk.  Called before the
+    /// statistics are printed, so that they count these writes.
+    void FlushAtHalt();
+
+    /// Have the read-ahead thread bring `count` sectors into the cache,
+    /// unless they are there already.  Return at once; sectors that do not
+    /// fit in the queue are dropped.
+    void Prefetch(const int *sectorNumbers, unsigned count);
+
+    /// Body of the read-ahead thread.
+    void ReadAhead();
+
+private:
+    struct Entry {
+        int sector;  ///< Sector held, or -1.
+        bool dirty;  ///< Was it written since it was read or flushed?
+        unsigned pins;  ///< Threads using the entry, which cannot be
+                        ///< replaced while this is not 0.
+        bool readAhead;  ///< Was it read ahead, and not used since?
+        ReadWriteController *access;
+        char data[SECTOR_SIZE];
+    };
+
+    SynchDisk *disk;
+    Entry *entries;
+    unsigned size;
+
+    /// Hash table of the cached sectors, chained through `hashNext`; -1
+    /// ends a chain.
+    int *buckets;
+    int *hashNext;
+
+    /// Entries from least to most recently used, as a circular
+    /// doubly-linked list threaded through `lruNext` and `lruPrev`.  Index
+    /// `size` is the head of the list.
+    unsigned *lruNext;
+    unsigned *lruPrev;
+
+    /// Sectors waiting to be read ahead, in a ring starting at
+    /// `readAheadStart`.
+    int readAheadQueue[READ_AHEAD_QUEUE_SIZE];
+    unsigned readAheadStart;
+    unsigned readAheadCount;
+
+    Thread *readAheadThread;
+
+    /// Signalled when there are sectors to read ahead.
+    Semaphore *readAheadReady;
+
+    /// Value of `stats->totalTicks` at the last flush.
+    unsigned long lastFlush;
+
+    /// Is a flush in progress?
+    bool flushing;
+
+    /// Entries being flushed, and their sectors and data.
+    unsigned *flushEntries;
+    int *flushSectors;
+    const char **flushData;
+
+    unsigned Bucket(int sector) const;
+
+    /// Return the entry holding `sector`, or -1.
+    int Find(int sector) const;
+
+    void Unhash(unsigned which);
+
+    /// Return the entry holding `sector`, pinned, and set `hit`.
+    ///
+    /// If there is none, make the least recently used entry that nobody
+    /// uses hold `sector`, writing it back first if it is dirty, and return
+    /// it pinned and held for writing, without its data; `hit` is cleared.
+    /// Return -1 if every entry is in use.
+    int Lookup(int sector, bool *hit);
+
+    /// Write entry `which` back to disk, if it is dirty.
+    void WriteBack(unsigned which);
+
+    /// Make entry `which` the most recently used one.
+    void Touch(unsigned which);
+
+};
+
+
+#endif
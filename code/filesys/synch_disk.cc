@@ -3,9 +3,10 @@
 /// happens later on).  This is a layer on top of the disk providing a
 /// synchronous interface (requests wait until the request completes).
 ///
-/// Use a semaphore to synchronize the interrupt handlers with the pending
-/// requests.  And, because the physical disk can only handle one operation
-/// at a time, use a lock to enforce mutual exclusion.
+/// Because the physical disk can only handle one operation at a time,
+/// requests made while it is busy wait in a queue, which is only touched
+/// with interrupts disabled, since the interrupt handler starts the next
+/// request.  Waiting threads are woken up by a callback on a semaphore.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -14,6 +15,15 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static const char *POLICY_NAMES[NUM_DISK_POLICIES] = {
+    "fifo", "sstf", "scan", "clook"
+};
 
 
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
@@ -31,19 +41,68 @@ DiskRequestDone(void *arg)
 ///
 /// * `name` is a UNIX file name to be used as storage for the disk data
 ///   (usually, `DISK`).
-SynchDisk::SynchDisk(const char *name)
+/// * `policy_` orders the requests waiting for the disk.
+SynchDisk::SynchDisk(const char *name, DiskSchedulingPolicy policy_)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    ASSERT(policy_ < NUM_DISK_POLICIES);
+
     disk = new Disk(name, DiskRequestDone, this);
+    policy = policy_;
+    active = nullptr;
+    pendingHead = pendingTail = nullptr;
+    headSector = 0;
+    sweepingUp = true;
+    halting = false;
+    stats->diskSchedulingName = GetPolicyName(policy);
 }
 
 /// De-allocate data structures needed for the synchronous disk abstraction.
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+}
+
+const char *
+SynchDisk::GetPolicyName(DiskSchedulingPolicy policy)
+{
+    ASSERT(policy < NUM_DISK_POLICIES);
+    return POLICY_NAMES[policy];
+}
+
+bool
+SynchDisk::ParsePolicy(const char *name, DiskSchedulingPolicy *policy)
+{
+    ASSERT(name != nullptr);
+    ASSERT(policy != nullptr);
+
+    for (unsigned i = 0; i < NUM_DISK_POLICIES; i++) {
+        if (!strcmp(name, POLICY_NAMES[i])) {
+            *policy = (DiskSchedulingPolicy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Change the policy.  Requests already queued are served by the new one.
+void
+SynchDisk::SetPolicy(DiskSchedulingPolicy newPolicy)
+{
+    ASSERT(newPolicy < NUM_DISK_POLICIES);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    policy = newPolicy;
+    sweepingUp = true;
+    interrupt->SetLevel(oldLevel);
+    stats->diskSchedulingName = GetPolicyName(policy);
+}
+
+/// Wake up the thread waiting on the semaphore `arg`.
+static void
+SignalRequestDone(void *arg)
+{
+    ASSERT(arg != nullptr);
+    ((Semaphore *) arg)->V();
 }
 
 /// Read the contents of a disk sector into a buffer.  Return only after the
@@ -56,10 +115,7 @@ SynchDisk::ReadSector(int sectorNumber, char *data)
 {
     ASSERT(data != nullptr);
 
-    lock->Acquire();  // Only one disk I/O at a time.
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();   // Wait for interrupt.
-    lock->Release();
+    SubmitAndWait(&sectorNumber, &data, 1, false);
 }
 
 /// Write the contents of a buffer into a disk sector.  Return only
@@ -72,16 +128,199 @@ SynchDisk::WriteSector(int sectorNumber, const char *data)
 {
     ASSERT(data != nullptr);
 
-    lock->Acquire();  // only one disk I/O at a time
+    char *buffer = (char *) data;  // Only read from.
+    SubmitAndWait(&sectorNumber, &buffer, 1, true);
+}
+
+/// Read the contents of several disk sectors, each into its own buffer.
+/// Return only after all of them have been read.
+///
+/// * `sectorNumbers` are the disk sectors to read.
+/// * `data` are the buffers to hold their contents.
+/// * `count` is the number of sectors.
+void
+SynchDisk::ReadSectors(const int *sectorNumbers, char *const *data,
+                       unsigned count)
+{
+    ASSERT(sectorNumbers != nullptr);
+    ASSERT(data != nullptr);
+
+    SubmitAndWait(sectorNumbers, data, count, false);
+}
+
+/// Write several buffers into disk sectors.  Return only after all of them
+/// have been written.
+///
+/// * `sectorNumbers` are the disk sectors to be written.
+/// * `data` are their new contents.
+/// * `count` is the number of sectors.
+void
+SynchDisk::WriteSectors(const int *sectorNumbers, const char *const *data,
+                        unsigned count)
+{
+    ASSERT(sectorNumbers != nullptr);
+    ASSERT(data != nullptr);
+
+    SubmitAndWait(sectorNumbers, (char *const *) data, count, true);
+}
+
+/// The requests are made in batches of at most a track, kept on the stack.
+void
+SynchDisk::SubmitAndWait(const int *sectorNumbers, char *const *data,
+                         unsigned count, bool writing)
+{
+    Semaphore done("disk request done", 0);
+    DiskRequest requests[SECTORS_PER_TRACK];
+
+    while (count > 0) {
+        unsigned batch = count < SECTORS_PER_TRACK ? count
+                                                   : SECTORS_PER_TRACK;
+        for (unsigned i = 0; i < batch; i++) {
+            ASSERT(data[i] != nullptr);
+            requests[i].sector = sectorNumbers[i];
+            requests[i].data = data[i];
+            requests[i].writing = writing;
+            requests[i].callback = SignalRequestDone;
+            requests[i].callbackArg = &done;
+            Submit(&requests[i]);
+        }
+        for (unsigned i = 0; i < batch; i++) {
+            done.P();
+        }
+        sectorNumbers += batch;
+        data += batch;
+        count -= batch;
+    }
+}
+
+void
+SynchDisk::Submit(DiskRequest *request)
+{
+    ASSERT(request != nullptr);
+    ASSERT(request->sector >= 0
+             && (unsigned) request->sector < NUM_SECTORS);
+    ASSERT(request->callback != nullptr);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    request->submitTicks = stats->totalTicks;
+    request->next = nullptr;
+    if (active == nullptr && !halting) {
+        Start(request);
+    } else {
+        if (pendingTail == nullptr) {
+            pendingHead = request;
+        } else {
+            pendingTail->next = request;
+        }
+        pendingTail = request;
+        stats->numDiskRequestsQueued++;
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    active = request;
+    if (request->sector != headSector) {
+        sweepingUp = request->sector > headSector;
+    }
+    headSector = request->sector;
+    if (request->writing) {
+        disk->WriteRequest(request->sector, request->data);
+    } else {
+        disk->ReadRequest(request->sector, request->data);
+    }
+}
+
+/// Unlink and return the pending request that `policy` serves next.
+///
+/// The queue is short, since each thread waits for its requests, so it is
+/// simply scanned.  Distances are measured in sectors, which orders the
+/// requests by track as the disk numbers sectors track after track.
+DiskRequest *
+SynchDisk::PickNext()
+{
+    ASSERT(pendingHead != nullptr);
+
+    DiskRequest **chosen = &pendingHead;
+    if (policy != DISK_FIFO) {
+        DiskRequest **lowest = &pendingHead;  // For C-LOOK wrapping around.
+        DiskRequest **ahead = nullptr;        // Closest in the sweep.
+        for (DiskRequest **link = &pendingHead; *link != nullptr;
+               link = &(*link)->next) {
+            int sector = (*link)->sector;
+            if (sector < (*lowest)->sector) {
+                lowest = link;
+            }
+            if (policy == DISK_SSTF) {
+                if (abs(sector - headSector)
+                      < abs((*chosen)->sector - headSector)) {
+                    chosen = link;
+                }
+                continue;
+            }
+            bool isAhead = policy == DISK_SCAN && !sweepingUp
+                           ? sector <= headSector : sector >= headSector;
+            if (isAhead && (ahead == nullptr
+                              || abs(sector - headSector)
+                                   < abs((*ahead)->sector - headSector))) {
+                ahead = link;
+            }
+        }
+        if (policy == DISK_SCAN) {
+            if (ahead == nullptr) {  // Nothing left this way: turn around.
+                sweepingUp = !sweepingUp;
+                return PickNext();
+            }
+            chosen = ahead;
+        } else if (policy == DISK_CLOOK) {
+            chosen = ahead != nullptr ? ahead : lowest;
+        }
+    }
+
+    DiskRequest *request = *chosen;
+    *chosen = request->next;
+    if (pendingTail == request) {
+        pendingTail = nullptr;
+        for (DiskRequest *r = pendingHead; r != nullptr; r = r->next) {
+            pendingTail = r;
+        }
+    }
+    return request;
+}
+
+/// The simulated disk stores the data as soon as it is asked to, so the
+/// request is completed right away, as is any request cut short by the
+/// halt.
+void
+SynchDisk::WriteSectorAtHalt(int sectorNumber, const char *data)
+{
+    ASSERT(data != nullptr);
+
+    halting = true;
+    if (active != nullptr) {
+        disk->HandleInterrupt();
+    }
     disk->WriteRequest(sectorNumber, data);
-    semaphore->P();   // wait for interrupt
-    lock->Release();
+    disk->HandleInterrupt();
 }
 
-/// Disk interrupt handler.  Wake up any thread waiting for the disk
-/// request to finish.
+/// Disk interrupt handler.  Start the next request, if any, and then tell
+/// whoever made the one just done.
 void
 SynchDisk::RequestDone()
 {
-    semaphore->V();
+    DiskRequest *done = active;
+    active = nullptr;
+    if (done == nullptr) {  // A write made while halting.
+        return;
+    }
+
+    stats->numDiskRequests++;
+    stats->diskRequestTicks += stats->totalTicks - done->submitTicks;
+    if (pendingHead != nullptr && !halting) {
+        Start(PickNext());
+    }
+    done->callback(done->callbackArg);
 }
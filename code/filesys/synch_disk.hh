@@ -10,10 +10,38 @@
 
 
 #include "machine/disk.hh"
-#include "threads/lock.hh"
 #include "threads/semaphore.hh"
 
 
+/// Orders in which the pending disk requests are served.
+enum DiskSchedulingPolicy {
+    DISK_FIFO,   ///< In the order they were made.
+    DISK_SSTF,   ///< Shortest seek time first: the closest to the head.
+                 ///< Can starve far requests.
+    DISK_SCAN,   ///< Elevator: sweep up to the last request, then down.
+    DISK_CLOOK,  ///< Sweep up to the last request, then jump back to the
+                 ///< lowest one.
+    NUM_DISK_POLICIES
+};
+
+/// A request to the disk, made with `SynchDisk::Submit`.
+///
+/// The request belongs to whoever submits it, and must stay alive until
+/// its callback is invoked.
+struct DiskRequest {
+    int sector;
+    char *data;  ///< Buffer to read into, or holding the data to write.
+    bool writing;
+
+    /// Called with `callbackArg` once the request is done, from the disk
+    /// interrupt handler, so with interrupts disabled.
+    VoidFunctionPtr callback;
+    void *callbackArg;
+
+    unsigned long submitTicks;  ///< For the latency statistics.
+    DiskRequest *next;  ///< Next pending request, in submission order.
+};
+
 /// The following class defines a "synchronous" disk abstraction.
 ///
 /// As with other I/O devices, the raw physical disk is an asynchronous
@@ -24,33 +52,95 @@
 ///
 /// This class provides the abstraction that for any individual thread making
 /// a request, it waits around until the operation finishes before returning.
+///
+/// Requests made while the disk is busy are queued, and the scheduling
+/// policy picks the one served next when the disk is done, so that requests
+/// from several threads can be reordered by track.
 class SynchDisk {
 public:
 
     /// Initialize a synchronous disk, by initializing the raw Disk.
-    SynchDisk(const char *name);
+    SynchDisk(const char *name, DiskSchedulingPolicy policy = DISK_FIFO);
 
     /// De-allocate the synch disk data.
     ~SynchDisk();
 
     /// Read/write a disk sector, returning only once the data is actually
-    /// read or written.  These call `Disk::ReadRequest`/`WriteRequest` and
-    /// then wait until the request is done.
+    /// read or written.  These submit the request and then wait until it
+    /// is done.
 
     void ReadSector(int sectorNumber, char *data);
     void WriteSector(int sectorNumber, const char *data);
 
+    /// Read/write `count` sectors, sector `sectorNumbers[i]` from/into
+    /// buffer `data[i]`.  All the requests are queued at once, so that the
+    /// scheduling policy can serve them in the best order.
+
+    void ReadSectors(const int *sectorNumbers, char *const *data,
+                     unsigned count);
+    void WriteSectors(const int *sectorNumbers, const char *const *data,
+                      unsigned count);
+
+    /// Queue `request`, and return without waiting for it.  Its callback is
+    /// invoked once it is done.
+    void Submit(DiskRequest *request);
+
+    /// Write a disk sector while Nachos halts, when threads can no longer
+    /// wait for the disk.  Requests still queued are not served.
+    void WriteSectorAtHalt(int sectorNumber, const char *data);
+
     /// Called by the disk device interrupt handler, to signal that the
     /// current disk operation is complete.
     void RequestDone();
 
+    void SetPolicy(DiskSchedulingPolicy newPolicy);
+
+    DiskSchedulingPolicy GetPolicy() const;
+
+    /// Return the name of `policy`.
+    static const char *GetPolicyName(DiskSchedulingPolicy policy);
+
+    /// Find the policy called `name`: `fifo`, `sstf`, `scan` or `clook`.
+    /// Return false if there is no such policy.
+    static bool ParsePolicy(const char *name, DiskSchedulingPolicy *policy);
+
 private:
     Disk *disk;  ///< Raw disk device.
-    Semaphore *semaphore;  ///< To synchronize requesting thread with the
-                           ///< interrupt handler.
-    Lock *lock;  ///< Only one read/write request can be sent to the disk at
-                 ///< a time.
+
+    DiskSchedulingPolicy policy;
+
+    /// Request being served by the disk, if any.
+    DiskRequest *active;
+
+    /// Requests waiting for the disk, in submission order.
+    DiskRequest *pendingHead;
+    DiskRequest *pendingTail;
+
+    /// Sector under the head once the active request is done.
+    int headSector;
+
+    /// Direction of the SCAN sweep.
+    bool sweepingUp;
+
+    /// Set once Nachos halts, to stop serving queued requests.
+    bool halting;
+
+    /// Remove the request the policy serves next from the pending ones.
+    DiskRequest *PickNext();
+
+    /// Send `request` to the disk.
+    void Start(DiskRequest *request);
+
+    /// Submit `count` requests, and wait until all of them are done.
+    void SubmitAndWait(const int *sectorNumbers, char *const *data,
+                       unsigned count, bool writing);
 };
 
+inline DiskSchedulingPolicy
+SynchDisk::GetPolicy() const
+{
+    return policy;
+}
+
 
 #endif
@@ -8,6 +8,7 @@
 
 
 #include "bitmap.hh"
+#include "machine/disk.hh"
 
 #include <stdio.h>
 
@@ -23,9 +24,11 @@ Bitmap::Bitmap(unsigned nitems)
     numBits  = nitems;
     numWords = DivRoundUp(numBits, BITS_IN_WORD);
     map      = new unsigned [numWords];
-    for (unsigned i = 0; i < numBits; i++) {
-        Clear(i);
+    for (unsigned i = 0; i < numWords; i++) {
+        map[i] = 0;
     }
+    dirtyFirst = 0;
+    dirtyLast = numWords - 1;
 }
 
 /// De-allocate a bitmap.
@@ -41,7 +44,10 @@ void
 Bitmap::Mark(unsigned which)
 {
     ASSERT(which < numBits);
-    map[which / BITS_IN_WORD] |= 1 << which % BITS_IN_WORD;
+
+    unsigned word = which / BITS_IN_WORD;
+    map[word] |= 1 << which % BITS_IN_WORD;
+    MarkDirty(word);
 }
 
 /// Clear the “nth” bit in a bitmap.
@@ -51,7 +57,23 @@ void
 Bitmap::Clear(unsigned which)
 {
     ASSERT(which < numBits);
-    map[which / BITS_IN_WORD] &= ~(1 << which % BITS_IN_WORD);
+
+    unsigned word = which / BITS_IN_WORD;
+    map[word] &= ~(1 << which % BITS_IN_WORD);
+    MarkDirty(word);
+}
+
+/// Add word `word` to the range of words to be written back.
+void
+Bitmap::MarkDirty(unsigned word)
+{
+    if (dirtyFirst > dirtyLast) {
+        dirtyFirst = dirtyLast = word;
+    } else if (word < dirtyFirst) {
+        dirtyFirst = word;
+    } else if (word > dirtyLast) {
+        dirtyLast = word;
+    }
 }
 
 /// Return true if the “nth” bit is set.
@@ -67,14 +89,56 @@ Bitmap::Test(unsigned which) const
 /// Return the number of the first bit which is clear.  As a side effect, set
 /// the bit (mark it as in use).  (In other words, find and allocate a bit.)
 ///
+/// Whole words are skipped while they are full, and the first clear bit of a
+/// word is found by counting the trailing ones.
+///
 /// If no bits are clear, return -1.
 int
 Bitmap::Find()
 {
-    for (unsigned i = 0; i < numBits; i++) {
-        if (!Test(i)) {
-            Mark(i);
-            return i;
+    for (unsigned i = 0; i < numWords; i++) {
+        if (map[i] != ~0U) {
+            unsigned which = i * BITS_IN_WORD + __builtin_ctz(~map[i]);
+            if (which >= numBits) {
+                return -1;  // Only the padding of the last word is clear.
+            }
+            Mark(which);
+            return which;
+        }
+    }
+    return -1;
+}
+
+int
+Bitmap::FindRun(unsigned count, unsigned goal) const
+{
+    ASSERT(count > 0);
+
+    if (goal >= numBits) {
+        goal = 0;
+    }
+    int first = FindRunFrom(count, goal);
+    if (first == -1 && goal > 0) {
+        first = FindRunFrom(count, 0);
+    }
+    return first;
+}
+
+/// Full words are skipped while no run is under way.
+int
+Bitmap::FindRunFrom(unsigned count, unsigned from) const
+{
+    unsigned length = 0;
+    for (unsigned i = from; i < numBits; i++) {
+        if (length == 0 && i % BITS_IN_WORD == 0
+              && map[i / BITS_IN_WORD] == ~0U) {
+            i += BITS_IN_WORD - 1;
+            continue;
+        }
+        if (Test(i)) {
+            length = 0;
+        } else if (++length == count) {
+            return i + 1 - count;
         }
     }
     return -1;
@@ -85,14 +149,11 @@ Bitmap::Find()
 unsigned
 Bitmap::CountClear() const
 {
-    unsigned count = 0;
-
-    for (unsigned i = 0; i < numBits; i++) {
-        if (!Test(i)) {
-            count++;
-        }
+    unsigned set = 0;
+    for (unsigned i = 0; i < numWords; i++) {
+        set += __builtin_popcount(map[i]);
     }
-    return count;
+    return numBits - set;
 }
 
 /// Print the contents of the bitmap, for debugging.
@@ -121,6 +182,8 @@ Bitmap::FetchFrom(OpenFile *file)
 {
     ASSERT(file != nullptr);
     file->ReadAt((char *) map, numWords * sizeof (unsigned), 0);
+    dirtyFirst = numWords;
+    dirtyLast = 0;
 }
 
 /// Store the contents of a bitmap to a Nachos file.
@@ -134,3 +197,30 @@ Bitmap::WriteBack(OpenFile *file) const
     ASSERT(file != nullptr);
     file->WriteAt((char *) map, numWords * sizeof (unsigned), 0);
 }
+
+/// Store the changed words of a bitmap to a Nachos file, in one write.
+///
+/// The write is widened to whole sectors, so that the file does not have to
+/// read the rest of a sector before writing it.
+///
+/// * `file` is the place to write the bitmap to.
+void
+Bitmap::WriteBackDirty(OpenFile *file)
+{
+    ASSERT(file != nullptr);
+
+    if (dirtyFirst > dirtyLast) {
+        return;
+    }
+    unsigned wordSize = sizeof (unsigned);
+    unsigned size = numWords * wordSize;
+    unsigned first = dirtyFirst * wordSize / SECTOR_SIZE * SECTOR_SIZE;
+    unsigned end = DivRoundUp((dirtyLast + 1) * wordSize, SECTOR_SIZE)
+                   * SECTOR_SIZE;
+    if (end > size) {
+        end = size;
+    }
+    file->WriteAt((char *) map + first, end - first, first);
+    dirtyFirst = numWords;
+    dirtyLast = 0;
+}
@@ -50,11 +50,19 @@ public:
     /// Is the “nth” bit set?
     bool Test(unsigned which) const;
 
-    /// Return the index of a clear bit, and as a side effect, set the bit.
+    /// Return the index of the first clear bit, and as a side effect, set
+    /// the bit.
     ///
     /// If no bits are clear, return -1.
     int Find();
 
+    /// Return the index of the first of `count` consecutive clear bits,
+    /// looking from bit `goal` on, and then from the start.  Unlike `Find`,
+    /// the bits are left clear.
+    ///
+    /// If there is no such run, return -1.
+    int FindRun(unsigned count, unsigned goal) const;
+
     /// Return the number of clear bits.
     unsigned CountClear() const;
 
@@ -73,6 +81,10 @@ public:
     /// need to read and write the bitmap to a file.
     void WriteBack(OpenFile *file) const;
 
+    /// Write to disk only the words changed since the last `FetchFrom` or
+    /// `WriteBackDirty`.
+    void WriteBackDirty(OpenFile *file);
+
 private:
 
     /// Number of bits in the bitmap.
@@ -85,6 +97,16 @@ private:
     /// Bit storage.
     unsigned *map;
 
+    /// Range of words changed since the last `FetchFrom` or
+    /// `WriteBackDirty`; empty if `dirtyFirst > dirtyLast`.
+    unsigned dirtyFirst;
+    unsigned dirtyLast;
+
+    void MarkDirty(unsigned word);
+
+    /// Look for a run of `count` clear bits starting at `from` or after.
+    int FindRunFrom(unsigned count, unsigned from) const;
+
 };
 
 
@@ -1,17 +1,40 @@
 #include "coremap.hh"
-#include "stdlib.h"
-#include "time.h"
+#include "threads/system.hh"
 
-Coremap::Coremap(unsigned size)
+#include <string.h>
+
+static const char *POLICY_NAMES[NUM_REPLACEMENT_POLICIES] = {
+    "random", "fifo", "lru", "clock", "eclock"
+};
+
+Coremap::Coremap(unsigned size, ReplacementPolicy policy_)
 {
-    srand(time(NULL));
+    ASSERT(policy_ < NUM_REPLACEMENT_POLICIES);
+
     framesMap = new Bitmap(size);
     virtualPages = new unsigned[size];
-    spaces = new AddressSpace*[size];
+    spaces = new AddressSpace*[size]();
     mapSize = size;
-    #if defined(POLICY_FIFO) || defined(POLICY_LRU)
-    pagesQueue = new List<unsigned>;
-    #endif
+    policy = policy_;
+    queueNext = new unsigned[size + 1];
+    queuePrev = new unsigned[size + 1];
+    for (unsigned i = 0; i <= size; i++) {
+        queueNext[i] = i;
+        queuePrev[i] = i;
+    }
+    hand = 0;
+    cleanAhead = 0;
+    sharers = new Sharer*[size]();
+    cacheBuckets = new int[2 * size];
+    for (unsigned i = 0; i < 2 * size; i++) {
+        cacheBuckets[i] = -1;
+    }
+    cacheNext = new int[size];
+    cacheFile = new unsigned long[size];
+    cachePage = new unsigned[size];
+    cached = new bool[size]();
+    zeroFrame = 0;
+    zeroMappings = 0;
 }
 
 Coremap::~Coremap()
@@ -19,37 +42,368 @@ Coremap::~Coremap()
     delete framesMap;
     delete [] spaces;
     delete [] virtualPages;
-    #if defined(FIFO) || defined(LRU)
-    delete pagesQueue;
-    #endif
+    delete [] queueNext;
+    delete [] queuePrev;
+    for (unsigned i = 0; i < mapSize; i++) {
+        while (sharers[i] != nullptr) {
+            Sharer *next = sharers[i]->next;
+            delete sharers[i];
+            sharers[i] = next;
+        }
+    }
+    delete [] sharers;
+    delete [] cacheBuckets;
+    delete [] cacheNext;
+    delete [] cacheFile;
+    delete [] cachePage;
+    delete [] cached;
+}
+
+const char *
+Coremap::GetPolicyName(ReplacementPolicy policy)
+{
+    ASSERT(policy < NUM_REPLACEMENT_POLICIES);
+    return POLICY_NAMES[policy];
+}
+
+bool
+Coremap::ParsePolicy(const char *name, ReplacementPolicy *policy)
+{
+    ASSERT(name != nullptr);
+    ASSERT(policy != nullptr);
+
+    for (unsigned i = 0; i < NUM_REPLACEMENT_POLICIES; i++) {
+        if (!strcmp(name, POLICY_NAMES[i])) {
+            *policy = (ReplacementPolicy) i;
+            return true;
+        }
+    }
+    return false;
 }
 
 int
 Coremap::Find(unsigned vpn, AddressSpace *space)
 {
     DEBUG('p', "%u finding physical frame\n", vpn);
+    #ifdef SWAP
+    int page = Allocate();
+    if (page == -1) {
+        return -1;
+    }
+    virtualPages[page] = vpn;
+    spaces[page] = space;
+    if (policy == REPLACE_FIFO || policy == REPLACE_LRU) {
+        Enqueue(page);
+    }
+    #else
+    int page = framesMap->Find();
+    #endif
+    return page;
+}
+
+int
+Coremap::Allocate()
+{
     int page = framesMap->Find();
     #ifdef SWAP
     if (page == -1)
     {
         page = PickVictim();
         DEBUG('p', "Frames full. Page %u picked victim\n", page);
-        spaces[page]->WriteToSwap(virtualPages[page]);
+        if (!Evict(page)) {
+            return -1;
+        }
     }
-    virtualPages[page] = vpn;
-    spaces[page] = space;
-    #if defined(FIFO) || defined(LRU)
-    pagesQueue->Append(page);
-    #endif
     #endif
     return page;
 }
 
+int
+Coremap::MapZeroFrame()
+{
+    if (zeroMappings == 0) {
+        int frame = Allocate();
+        if (frame == -1) {
+            return -1;
+        }
+        zeroFrame = frame;
+        spaces[zeroFrame] = nullptr;  // A victim is still mapped to its
+        Dequeue(zeroFrame);           // last page.
+        DEBUG('p', "Frame %u is the zero frame\n", zeroFrame);
+        machine->GetMMU()->InvalidateFrame(zeroFrame);
+        memset(machine->GetMMU()->mainMemory + zeroFrame * PAGE_SIZE, 0,
+               PAGE_SIZE);
+    }
+    zeroMappings++;
+    return zeroFrame;
+}
+
+void
+Coremap::UnmapZeroFrame()
+{
+    ASSERT(zeroMappings > 0);
+
+    if (--zeroMappings == 0) {
+        Clear(zeroFrame);
+    }
+}
+
 void
 Coremap::Clear(unsigned which)
 {
+    ASSERT(sharers[which] == nullptr);
+
     framesMap->Clear(which);
     spaces[which] = nullptr;
+    Dequeue(which);
+    Unpublish(which);
+}
+
+unsigned
+Coremap::CacheBucket(unsigned long file, unsigned page) const
+{
+    return (file * 31 + page) % (2 * mapSize);
+}
+
+int
+Coremap::FindShared(unsigned long file, unsigned page)
+{
+    for (int i = cacheBuckets[CacheBucket(file, page)]; i != -1;
+           i = cacheNext[i]) {
+        if (cacheFile[i] == file && cachePage[i] == page) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+Coremap::Publish(unsigned which, unsigned long file, unsigned page)
+{
+    ASSERT(which < mapSize);
+    ASSERT(!cached[which]);
+    ASSERT(FindShared(file, page) == -1);
+
+    unsigned bucket = CacheBucket(file, page);
+    cacheFile[which] = file;
+    cachePage[which] = page;
+    cacheNext[which] = cacheBuckets[bucket];
+    cacheBuckets[bucket] = which;
+    cached[which] = true;
+}
+
+void
+Coremap::Unpublish(unsigned which)
+{
+    if (!cached[which]) {
+        return;
+    }
+    int *link = &cacheBuckets[CacheBucket(cacheFile[which],
+                                          cachePage[which])];
+    while (*link != (int) which) {
+        ASSERT(*link != -1);
+        link = &cacheNext[*link];
+    }
+    *link = cacheNext[which];
+    cached[which] = false;
+}
+
+void
+Coremap::Share(unsigned which, unsigned vpn, AddressSpace *space)
+{
+    ASSERT(which < mapSize);
+    ASSERT(spaces[which] != nullptr);
+    ASSERT(space != nullptr);
+
+    Sharer *sharer = new Sharer;
+    sharer->space = space;
+    sharer->vpn = vpn;
+    sharer->next = sharers[which];
+    sharers[which] = sharer;
+}
+
+void
+Coremap::Release(unsigned which, unsigned vpn, AddressSpace *space)
+{
+    ASSERT(which < mapSize);
+
+    if (spaces[which] == space && virtualPages[which] == vpn) {
+        Sharer *first = sharers[which];
+        if (first == nullptr) {
+            Clear(which);
+            return;
+        }
+        spaces[which] = first->space;
+        virtualPages[which] = first->vpn;
+        sharers[which] = first->next;
+        delete first;
+        return;
+    }
+
+    Sharer **link = &sharers[which];
+    while ((*link)->space != space || (*link)->vpn != vpn) {
+        link = &(*link)->next;
+        ASSERT(*link != nullptr);
+    }
+    Sharer *found = *link;
+    *link = found->next;
+    delete found;
+}
+
+void
+Coremap::GetFrameBits(unsigned which, bool *use, bool *dirty)
+{
+#ifdef SWAP
+    TranslationEntry *entry =
+      spaces[which]->SyncPageBits(virtualPages[which]);
+    *use = entry->use;
+    *dirty = entry->dirty;
+    for (Sharer *s = sharers[which]; s != nullptr; s = s->next) {
+        entry = s->space->SyncPageBits(s->vpn);
+        *use = *use || entry->use;
+        *dirty = *dirty || entry->dirty;
+    }
+#endif
+}
+
+void
+Coremap::ClearFrameUse(unsigned which)
+{
+#ifdef SWAP
+    spaces[which]->SyncPageBits(virtualPages[which])->use = false;
+    for (Sharer *s = sharers[which]; s != nullptr; s = s->next) {
+        s->space->SyncPageBits(s->vpn)->use = false;
+    }
+#endif
+}
+
+unsigned
+Coremap::VictimOrder(unsigned *order) const
+{
+    unsigned count = 0;
+    if (policy == REPLACE_FIFO || policy == REPLACE_LRU) {
+        for (unsigned i = queueNext[mapSize]; i != mapSize;
+               i = queueNext[i]) {
+            order[count++] = i;
+        }
+    } else {
+        for (unsigned i = 0; i < mapSize; i++) {
+            unsigned frame = (hand + i) % mapSize;
+            if (spaces[frame] != nullptr) {
+                order[count++] = frame;
+            }
+        }
+    }
+    return count;
+}
+
+/// Pages used since the clock last went by get a second chance, so they
+/// are skipped by the clock policies.  Frames shared by several pages are
+/// left for eviction to write back.
+unsigned
+Coremap::CleanAhead(unsigned target)
+{
+    unsigned written = 0;
+#ifdef SWAP
+    bool clock = policy == REPLACE_CLOCK || policy == REPLACE_ENHANCED_CLOCK;
+    unsigned *order = new unsigned [mapSize];
+    unsigned *frames = new unsigned [mapSize];
+    int *slots = new int [mapSize];
+    unsigned count = VictimOrder(order);
+    unsigned clean = 0;
+    unsigned i = 0;
+    for (; i < count && clean < target; i++) {
+        unsigned frame = order[i];
+        bool use, dirty;
+        GetFrameBits(frame, &use, &dirty);
+        if (use && clock) {
+            continue;
+        }
+        if (dirty) {
+            if (IsShared(frame)) {
+                continue;
+            }
+            int slot = spaces[frame]->CleanPage(
+              virtualPages[frame], written == 0 ? -1 : slots[written - 1] + 1);
+            if (slot == -1) {
+                continue;
+            }
+            // Keep the batch sorted by slot.
+            unsigned j = written++;
+            for (; j > 0 && slots[j - 1] > slot; j--) {
+                slots[j] = slots[j - 1];
+                frames[j] = frames[j - 1];
+            }
+            slots[j] = slot;
+            frames[j] = frame;
+        }
+        clean++;
+    }
+    if (policy == REPLACE_RANDOM && i > 0) {
+        hand = (order[i - 1] + 1) % mapSize;
+    }
+    cleanAhead = clean;
+
+    // The pages are already marked clean, so they are all copied before
+    // the first write blocks: meanwhile their frames may be evicted and
+    // reused.
+    const char *mainMemory = machine->GetMMU()->mainMemory;
+    char *buffer = new char [written * PAGE_SIZE];
+    for (unsigned j = 0; j < written; j++) {
+        memcpy(buffer + j * PAGE_SIZE,
+               mainMemory + frames[j] * PAGE_SIZE, PAGE_SIZE);
+    }
+    for (unsigned first = 0, n; first < written; first += n) {
+        n = 1;
+        while (first + n < written
+               && slots[first + n] == slots[first] + (int) n) {
+            n++;
+        }
+        DEBUG('p', "Cleaning %u pages into swap slots %d to %d\n",
+              n, slots[first], slots[first] + n - 1);
+        swapArea->WriteSlots(slots[first], n, buffer + first * PAGE_SIZE);
+        stats->numPageoutTransfers++;
+    }
+
+    delete [] buffer;
+    delete [] slots;
+    delete [] frames;
+    delete [] order;
+#endif
+    return written;
+}
+
+bool
+Coremap::Evict(unsigned which)
+{
+#ifdef SWAP
+    ASSERT(which < mapSize);
+    ASSERT(spaces[which] != nullptr);
+
+    unsigned needed = spaces[which]->SwapSlotsNeeded(virtualPages[which]);
+    for (Sharer *s = sharers[which]; s != nullptr; s = s->next) {
+        needed += s->space->SwapSlotsNeeded(s->vpn);
+    }
+    if (!swapArea->MakeRoom(needed)) {
+        DEBUG('p', "No swap space to evict frame %u\n", which);
+        return false;
+    }
+
+    stats->numPageEvictions++;
+    if (cleanAhead > 0) {
+        cleanAhead--;
+    }
+    spaces[which]->WriteToSwap(virtualPages[which]);
+    while (sharers[which] != nullptr) {
+        Sharer *next = sharers[which]->next;
+        sharers[which]->space->WriteToSwap(sharers[which]->vpn);
+        delete sharers[which];
+        sharers[which] = next;
+    }
+    Unpublish(which);
+    machine->GetMMU()->InvalidateFrame(which);
+#endif
+    return true;
 }
 
 int
@@ -61,16 +415,120 @@ Coremap::CountClear()
 unsigned
 Coremap::PickVictim()
 {
-    #if defined(FIFO) || defined(LRU)
-    return pagesQueue->Pop();
-    #else
-    return rand() % mapSize;
-    #endif
+    switch (policy) {
+        case REPLACE_FIFO:
+        case REPLACE_LRU: {
+            unsigned victim = queueNext[mapSize];
+            ASSERT(victim != mapSize);
+            Dequeue(victim);
+            return victim;
+        }
+        case REPLACE_CLOCK:
+            return PickClockVictim();
+        case REPLACE_ENHANCED_CLOCK:
+            return PickEnhancedClockVictim();
+        default: {
+            unsigned victim;
+            do {
+                victim = SystemDep::Random() % mapSize;
+            } while (spaces[victim] == nullptr);
+            return victim;
+        }
+    }
+}
+
+/// Sweep the frames, clearing the `use` bit of their pages, until one whose
+/// page was not used since the last sweep turns up.
+///
+/// Free frames are skipped by the sweeps of both clock policies.
+unsigned
+Coremap::PickClockVictim()
+{
+#ifdef SWAP
+    for (;;) {
+        unsigned frame = hand;
+        hand = (hand + 1) % mapSize;
+        if (spaces[frame] == nullptr) {
+            continue;
+        }
+        bool use, dirty;
+        GetFrameBits(frame, &use, &dirty);
+        if (!use) {
+            return frame;
+        }
+        ClearFrameUse(frame);
+    }
+#else
+    return 0;
+#endif
+}
+
+/// Look for a page that is neither used nor dirty, so that evicting it
+/// costs no swap write.  If there is none, look for an unused dirty page,
+/// clearing the `use` bits along the way, and start over if that fails too.
+/// At most four sweeps are needed.
+unsigned
+Coremap::PickEnhancedClockVictim()
+{
+#ifdef SWAP
+    for (;;) {
+        for (unsigned i = 0; i < mapSize; i++) {
+            unsigned frame = hand;
+            hand = (hand + 1) % mapSize;
+            if (spaces[frame] == nullptr) {
+                continue;
+            }
+            bool use, dirty;
+            GetFrameBits(frame, &use, &dirty);
+            if (!use && !dirty) {
+                return frame;
+            }
+        }
+        for (unsigned i = 0; i < mapSize; i++) {
+            unsigned frame = hand;
+            hand = (hand + 1) % mapSize;
+            if (spaces[frame] == nullptr) {
+                continue;
+            }
+            bool use, dirty;
+            GetFrameBits(frame, &use, &dirty);
+            if (!use) {
+                return frame;
+            }
+            ClearFrameUse(frame);
+        }
+    }
+#else
+    return 0;
+#endif
+}
+
+void
+Coremap::MoveToBack(unsigned which)
+{
+    ASSERT(which < mapSize);
+
+    if (queueNext[which] != which) {
+        Dequeue(which);
+        Enqueue(which);
+    }
+}
+
+void
+Coremap::Enqueue(unsigned which)
+{
+    unsigned last = queuePrev[mapSize];
+    queueNext[which] = mapSize;
+    queuePrev[which] = last;
+    queueNext[last] = which;
+    queuePrev[mapSize] = which;
 }
 
 void
-Coremap::PageUsed(unsigned which)
+Coremap::Dequeue(unsigned which)
 {
-    pagesQueue->Remove(which);
-    pagesQueue->Append(which);
-}
\ No newline at end of file
+    queueNext[queuePrev[which]] = queueNext[which];
+    queuePrev[queueNext[which]] = queuePrev[which];
+    queueNext[which] = which;
+    queuePrev[which] = which;
+}
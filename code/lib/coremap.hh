@@ -4,37 +4,210 @@
 #define NACHOS_LIB_COREMAP_HH
 
 #include "bitmap.hh"
-#include "list.hh"
 #include "userprog/address_space.hh"
 
+/// Algorithms to choose the frame to free when memory is full.
+enum ReplacementPolicy {
+    REPLACE_RANDOM,          ///< Any frame, chosen at random.
+    REPLACE_FIFO,            ///< The frame loaded longest ago.
+    REPLACE_LRU,             ///< The frame used least recently.
+    REPLACE_CLOCK,           ///< Second chance, using the `use` bit.
+    REPLACE_ENHANCED_CLOCK,  ///< Second chance preferring clean pages,
+                             ///< using the `use` and `dirty` bits.
+    NUM_REPLACEMENT_POLICIES
+};
+
 class Coremap {
 
 public:
-    Coremap(unsigned size);
+    Coremap(unsigned size, ReplacementPolicy policy = REPLACE_RANDOM);
 
     ~Coremap();
 
+    /// Take a frame for page `vpn` of `space`, evicting a page if there is
+    /// no free one, and return it.
+    ///
+    /// Return -1 if a page had to be evicted and the swap area has no room
+    /// for it.
     int Find(unsigned vpn, AddressSpace* space);
 
     void Clear(unsigned which);
 
     int CountClear();
 
+    /// Return the frame holding page `page` of the file identified by
+    /// `file`, or -1 if no frame holds it.
+    int FindShared(unsigned long file, unsigned page);
+
+    /// Record that frame `which`, which holds read-only page `page` of the
+    /// file identified by `file`, can be shared with `FindShared`.
+    void Publish(unsigned which, unsigned long file, unsigned page);
+
+    /// Map frame `which` into page `vpn` of `space` too.
+    void Share(unsigned which, unsigned vpn, AddressSpace *space);
+
+    /// Unmap frame `which` from page `vpn` of `space`, and free the frame if
+    /// no other page maps it.
+    void Release(unsigned which, unsigned vpn, AddressSpace *space);
+
+    /// Is frame `which` mapped by more than one page?
+    bool IsShared(unsigned which) const;
+
+    /// Map one more page to the zero frame, and return the frame, or -1 if
+    /// no frame could be taken for it.
+    ///
+    /// Pages that were never written to are mapped to this frame,
+    /// read-only, by any number of address spaces.  The frame is never
+    /// replaced, and is only held while some page maps it.
+    int MapZeroFrame();
+
+    /// Unmap one of the pages mapped to the zero frame.
+    void UnmapZeroFrame();
+
+    /// Is frame `which` the zero frame?
+    bool IsZeroFrame(unsigned which) const;
+
+    /// Write back the dirty pages among the next victims of the policy, so
+    /// that the faults that evict them find them clean.
+    ///
+    /// Victims are looked at in the order the policy would pick them, until
+    /// `target` clean ones are found.  The dirty ones are written to
+    /// neighbouring swap slots where possible, each run of slots in a
+    /// single transfer, and stay mapped.  Return the number of pages
+    /// written.
+    unsigned CleanAhead(unsigned target);
+
+    /// Return how many of the next victims are known to be clean: those
+    /// found by the last `CleanAhead`, less the pages evicted since.  Pages
+    /// written to again in between are not noticed.
+    unsigned CountCleanAhead() const;
+
+    /// Tell the coremap that frame `which` was just accessed.  Takes
+    /// constant time, and does nothing unless the policy is LRU.
     void PageUsed(unsigned which);
 
+    /// Return the name of `policy`.
+    static const char *GetPolicyName(ReplacementPolicy policy);
+
+    /// Find the policy called `name`: `random`, `fifo`, `lru`, `clock` or
+    /// `eclock`.  Return false if there is no such policy.
+    static bool ParsePolicy(const char *name, ReplacementPolicy *policy);
 
 private:
     Bitmap* framesMap;
 
+    /// Page and address space mapping each frame.  A shared frame keeps
+    /// its other mappings in `sharers`.
     unsigned *virtualPages;
 
     AddressSpace **spaces;
 
+    struct Sharer {
+        AddressSpace *space;
+        unsigned vpn;
+        Sharer *next;
+    };
+
+    Sharer **sharers;
+
+    /// Hash table of the frames that can be shared, keyed by file and page,
+    /// chained through `cacheNext`; -1 ends a chain.
+    int *cacheBuckets;
+    int *cacheNext;
+    unsigned long *cacheFile;
+    unsigned *cachePage;
+    bool *cached;
+
+    unsigned CacheBucket(unsigned long file, unsigned page) const;
+
+    /// Stop sharing frame `which` through `FindShared`.
+    void Unpublish(unsigned which);
+
+    /// Merge the `use` and `dirty` bits of every page mapped to frame
+    /// `which`.
+    void GetFrameBits(unsigned which, bool *use, bool *dirty);
+
+    /// Clear the `use` bit of every page mapped to frame `which`.
+    void ClearFrameUse(unsigned which);
+
     unsigned mapSize;
 
-    List <unsigned> *pagesQueue;
+    /// The zero frame, if `zeroMappings` is not zero.  It is not mapped in
+    /// `spaces`, so that no policy picks it.
+    unsigned zeroFrame;
+
+    unsigned zeroMappings;
+
+    /// Take a free frame, evicting a page if there is none.  Return -1 if
+    /// the page cannot be evicted.
+    int Allocate();
+
+    ReplacementPolicy policy;
+
+    /// Replacement queue of frames, oldest first, kept as a circular
+    /// doubly-linked list threaded through `queueNext` and `queuePrev`.
+    /// Only used by the FIFO and LRU policies.
+    ///
+    /// Index `mapSize` is the head of the list.  A frame that is not
+    /// queued links to itself.
+    unsigned *queueNext;
+    unsigned *queuePrev;
+
+    /// Next frame looked at by the clock policies.  With the random policy,
+    /// where `CleanAhead` starts looking.
+    unsigned hand;
+
+    unsigned cleanAhead;
+
+    /// Store in `order` the frames that can be replaced, in the order the
+    /// policy would look at them, and return how many there are.
+    unsigned VictimOrder(unsigned *order) const;
+
+    void Enqueue(unsigned which);
+
+    void Dequeue(unsigned which);
+
+    /// Evict the pages mapped to frame `which`, which stays allocated.
+    ///
+    /// Return false, changing nothing, if the swap area has no room for
+    /// them.
+    bool Evict(unsigned which);
+
+    /// Move frame `which` to the back of the queue.
+    void MoveToBack(unsigned which);
 
     unsigned PickVictim();
 
+    unsigned PickClockVictim();
+
+    unsigned PickEnhancedClockVictim();
+
 };
-#endif
\ No newline at end of file
+
+inline bool
+Coremap::IsShared(unsigned which) const
+{
+    return sharers[which] != nullptr;
+}
+
+inline bool
+Coremap::IsZeroFrame(unsigned which) const
+{
+    return zeroMappings > 0 && which == zeroFrame;
+}
+
+inline unsigned
+Coremap::CountCleanAhead() const
+{
+    return cleanAhead;
+}
+
+inline void
+Coremap::PageUsed(unsigned which)
+{
+    if (policy == REPLACE_LRU) {
+        MoveToBack(which);
+    }
+}
+
+#endif
@@ -0,0 +1,239 @@
+/// A priority queue kept as a binary min-heap.
+///
+/// Items are stored by value in an array that grows when it fills up, and
+/// is never shrunk, so once it reaches the largest size a program needs,
+/// inserting and removing items does not allocate memory anymore.
+///
+/// Items with equal keys come out in the order they were inserted, just
+/// like with `List::SortedInsert` and `List::SortedPop`.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_HEAP__HH
+#define NACHOS_LIB_HEAP__HH
+
+
+#include "utility.hh"
+
+
+template <class Item>
+class Heap {
+public:
+
+    /// Initialize an empty heap, with room for `initialSize` items.
+    Heap(unsigned initialSize = 16);
+
+    /// De-allocate the heap.
+    ~Heap();
+
+    /// Put `item` on the heap, with priority `key`.
+    void Insert(const Item &item, unsigned long key);
+
+    /// Remove the item with the lowest key and return it.
+    ///
+    /// If `keyPtr` is not null, the key of the item is stored there.  The
+    /// heap must not be empty.
+    Item Pop(unsigned long *keyPtr);
+
+    /// Move the item with the lowest key behind the other items with the
+    /// same key, as if it had been popped and inserted again, `times`
+    /// times in a row.
+    void Requeue(unsigned long times = 1);
+
+    /// Return the item with the lowest key, without removing it.
+    const Item &Head() const;
+
+    /// Return the lowest key.
+    unsigned long HeadKey() const;
+
+    bool IsEmpty() const;
+
+    unsigned Size() const;
+
+    /// Apply `func` to every item on the heap, in increasing key order.
+    void Apply(void (*func)(const Item &)) const;
+
+private:
+
+    class Element {
+    public:
+        Item item;
+        unsigned long key;
+        unsigned long order;  ///< Insertion number, to break ties.
+
+        bool Before(const Element &other) const
+        {
+            return key < other.key
+                   || (key == other.key && order < other.order);
+        }
+    };
+
+    Element *elements;  ///< The heap itself; children of `i` are at `2i+1`
+                        ///< and `2i+2`.
+    unsigned size;      ///< Number of items on the heap.
+    unsigned capacity;  ///< Number of items `elements` can hold.
+    unsigned long inserted;  ///< Number of items inserted so far.
+};
+
+
+template <class Item>
+Heap<Item>::Heap(unsigned initialSize)
+{
+    ASSERT(initialSize > 0);
+
+    elements = new Element [initialSize];
+    size     = 0;
+    capacity = initialSize;
+    inserted = 0;
+}
+
+template <class Item>
+Heap<Item>::~Heap()
+{
+    delete [] elements;
+}
+
+template <class Item>
+void
+Heap<Item>::Insert(const Item &item, unsigned long key)
+{
+    if (size == capacity) {
+        Element *larger = new Element [capacity * 2];
+        for (unsigned i = 0; i < size; i++) {
+            larger[i] = elements[i];
+        }
+        delete [] elements;
+        elements = larger;
+        capacity *= 2;
+    }
+
+    Element e;
+    e.item  = item;
+    e.key   = key;
+    e.order = inserted++;
+
+    // Sift up: move parents down until the place for `e` is found.
+    unsigned i = size++;
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!e.Before(elements[parent])) {
+            break;
+        }
+        elements[i] = elements[parent];
+        i = parent;
+    }
+    elements[i] = e;
+}
+
+template <class Item>
+Item
+Heap<Item>::Pop(unsigned long *keyPtr)
+{
+    ASSERT(size > 0);
+
+    Item item = elements[0].item;
+    if (keyPtr != nullptr) {
+        *keyPtr = elements[0].key;
+    }
+
+    // Sift down the last element from the root.
+    const Element &last = elements[--size];
+    unsigned i = 0;
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && elements[child + 1].Before(elements[child])) {
+            child++;
+        }
+        if (!elements[child].Before(last)) {
+            break;
+        }
+        elements[i] = elements[child];
+        i = child;
+    }
+    if (i != size) {
+        elements[i] = last;
+    }
+    return item;
+}
+
+template <class Item>
+void
+Heap<Item>::Requeue(unsigned long times)
+{
+    ASSERT(size > 0);
+
+    // If other items share the lowest key, one of them is a child of the
+    // root, since all of their ancestors must have that key too.
+    unsigned long key = elements[0].key;
+    if ((size < 2 || elements[1].key != key)
+          && (size < 3 || elements[2].key != key)) {
+        return;
+    }
+
+    unsigned equal = 0;
+    for (unsigned i = 0; i < size; i++) {
+        if (elements[i].key == key) {
+            equal++;
+        }
+    }
+    for (times %= equal; times > 0; times--) {
+        Insert(Pop(nullptr), key);
+    }
+}
+
+template <class Item>
+const Item &
+Heap<Item>::Head() const
+{
+    ASSERT(size > 0);
+
+    return elements[0].item;
+}
+
+template <class Item>
+unsigned long
+Heap<Item>::HeadKey() const
+{
+    ASSERT(size > 0);
+
+    return elements[0].key;
+}
+
+template <class Item>
+bool
+Heap<Item>::IsEmpty() const
+{
+    return size == 0;
+}
+
+template <class Item>
+unsigned
+Heap<Item>::Size() const
+{
+    return size;
+}
+
+template <class Item>
+void
+Heap<Item>::Apply(void (*func)(const Item &)) const
+{
+    ASSERT(func != nullptr);
+
+    // Only used for debugging, so sorting a copy is good enough.
+    Heap<Item> copy(capacity);
+    for (unsigned i = 0; i < size; i++) {
+        copy.elements[i] = elements[i];
+    }
+    copy.size = size;
+    while (!copy.IsEmpty()) {
+        func(copy.Pop(nullptr));
+    }
+}
+
+
+#endif
@@ -0,0 +1,41 @@
+/// Data structures for the basic-block execution engine.
+///
+/// When Nachos is built with `BLOCK_ENGINE`, user code is translated into
+/// basic blocks: straight-line runs of instructions that end after the
+/// delay slot of a branch or jump, at a system call, or at the end of a
+/// page.  Each instruction becomes an operation that already points to its
+/// handler and to the registers it uses, so that running a block does not
+/// fetch, translate nor decode anything.  See `mips_block.cc`.
+
+#ifndef NACHOS_MACHINE_BASICBLOCK__HH
+#define NACHOS_MACHINE_BASICBLOCK__HH
+
+
+#include "instruction.hh"
+#include "mmu.hh"
+
+
+/// One translated instruction.
+class BlockOp {
+public:
+    const void *handler;  ///< Where to dispatch to in `ExecBlock`.
+    int *rs, *rt, *rd;    ///< Registers used by the instruction.
+    int extra;            ///< Immediate; byte offset for branches and jumps.
+    Instruction instr;    ///< The instruction itself, for the handlers that
+                          ///< fall back to `ExecInstruction`.
+};
+
+/// A translated basic block.
+///
+/// Blocks are kept per physical word where they start, and are valid as
+/// long as the MMU version of their frame does not change.
+class BasicBlock {
+public:
+    unsigned frame;    ///< Physical frame holding the code.
+    unsigned version;  ///< Frame version the block was built from.
+    unsigned length;   ///< Number of operations in `ops`.
+    BlockOp ops[PAGE_SIZE / 4];
+};
+
+
+#endif
@@ -72,7 +72,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
+    pending       = new Heap<PendingInterrupt>;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
@@ -81,9 +81,6 @@ Interrupt::Interrupt()
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-        delete pending->Pop();
-    }
     delete pending;
 }
 
@@ -172,6 +169,54 @@ Interrupt::OneTick()
     }
 }
 
+/// Return the number of ticks that can elapse before a call to `OneTick`
+/// would do anything besides advancing the clock.
+///
+/// `OneTick` first advances time and then fires whatever is due, so an
+/// interrupt scheduled at time `when` lets `when - totalTicks - 1` ticks go
+/// by quietly.  A pending `YieldOnReturn` leaves no quiet ticks at all.
+unsigned long
+Interrupt::TicksUntilDue() const
+{
+    if (yieldOnReturn) {
+        return 0;
+    }
+    if (pending->IsEmpty()) {
+        return ULONG_MAX;
+    }
+
+    unsigned long when = pending->HeadKey();
+    unsigned long tick = status == SYSTEM_MODE ? SYSTEM_TICK : USER_TICK;
+    if (when <= stats->totalTicks + tick) {
+        return 0;
+    }
+    return (when - stats->totalTicks - 1) / tick;
+}
+
+/// Advance simulated time by several ticks in one step.
+///
+/// The caller must make sure that no interrupt becomes due in the meantime,
+/// by asking `TicksUntilDue` first.
+///
+/// * `ticks` is the number of ticks to account for.
+void
+Interrupt::AdvanceTicks(unsigned long ticks)
+{
+    if (status == SYSTEM_MODE) {
+        stats->totalTicks  += ticks * SYSTEM_TICK;
+        stats->systemTicks += ticks * SYSTEM_TICK;
+    } else {
+        stats->totalTicks += ticks * USER_TICK;
+        stats->userTicks  += ticks * USER_TICK;
+    }
+
+    // Each of those `OneTick` calls would have found the next interrupt not
+    // due yet and put it back on the queue.
+    if (!pending->IsEmpty()) {
+        pending->Requeue(ticks);
+    }
+}
+
 /// Called from within an interrupt handler, to cause a context switch (for
 /// example, on a time slice) in the interrupted thread, when the handler
 /// returns.
@@ -223,12 +268,15 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
+#ifdef FILESYS
+    sectorCache->FlushAtHalt();
+#endif
     stats->Print();
     Cleanup();  // Never returns.
 }
 
 #ifdef DFS_TICKS_FIX
-/// Restart the total ticks statistic and the pending interrupts list.
+/// Restart the total ticks statistic and the pending interrupts queue.
 ///
 /// This function makes sure Nachos keeps working even after overflowing the
 /// tick counter.  After some time (when `totalTicks` reach the maximum
@@ -237,14 +285,15 @@ Interrupt::Halt()
 void
 Interrupt::RestartTicks()
 {
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
+    Heap<PendingInterrupt> *oldPending = pending;
+    pending = new Heap<PendingInterrupt>(oldPending->Size());
 
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
+    while (!oldPending->IsEmpty()) {
+        unsigned long oldWhen;
+        PendingInterrupt i = oldPending->Pop(&oldWhen);
         unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
+        i.when = newWhen;
+        pending->Insert(i, newWhen);
         DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
               oldWhen, newWhen);
     }
@@ -258,7 +307,9 @@ Interrupt::RestartTicks()
 /// Arrange for the CPU to be interrupted when simulated time reaches `now +
 /// when`.
 ///
-/// Implementation: just put it on a sorted list.
+/// Implementation: just put it on a priority queue.  The queue keeps the
+/// interrupts by value and reuses its storage, so scheduling does not
+/// allocate memory once the queue has grown to the size the devices need.
 ///
 /// NOTE: the Nachos kernel should not call this routine directly.  Instead,
 /// it is only called by the hardware device simulators.
@@ -288,13 +339,11 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
 #endif
 
     unsigned when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
           INT_TYPE_NAMES[type], when);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(PendingInterrupt(handler, arg, when, type), when);
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -309,36 +358,37 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    unsigned      when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
     if (debug.IsEnabled('i')) {
         DumpState();
     }
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
-
-    if (toOccur == nullptr) {  // No pending interrupts.
+    if (pending->IsEmpty()) {  // No pending interrupts.
         return false;
     }
+    unsigned long when = pending->HeadKey();
 
     if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
         stats->idleTicks += (when - stats->totalTicks);
         stats->totalTicks = when;
     } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
+        pending->Requeue();
         return false;
     }
 
     // Check if there is nothing more to do, and if so, quit.
-    if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+    if (status == IDLE_MODE && pending->Head().type == TIMER_INT
+          && pending->Size() == 1) {
         return false;
     }
 
+    // The handler may schedule more interrupts, so take this one off the
+    // queue first.
+    PendingInterrupt toOccur = pending->Pop(nullptr);
+
     DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
-            INT_TYPE_NAMES[toOccur->type], toOccur->when);
+            INT_TYPE_NAMES[toOccur.type], toOccur.when);
 #ifdef USER_PROGRAM
     if (machine != nullptr) {
         machine->DelayedLoad(0, 0);
@@ -347,10 +397,9 @@ Interrupt::CheckIfDue(bool advanceClock)
     inHandler = true;
     status = SYSTEM_MODE;  // Whatever we were doing, we are now going to be
                            // running in the kernel.
-    (*toOccur->handler)(toOccur->arg);  // Call the interrupt handler.
+    (*toOccur.handler)(toOccur.arg);  // Call the interrupt handler.
     status = old;  // Restore the machine status.
     inHandler = false;
-    delete toOccur;
     return true;
 }
 
@@ -375,12 +424,10 @@ Interrupt::SetStatus(MachineStatus st)
 /// Print information about an interrupt that is scheduled to occur.  When,
 /// where, why, etc.
 static void
-PrintPending(PendingInterrupt *pend)
+PrintPending(const PendingInterrupt &pend)
 {
-    ASSERT(pend != nullptr);
-
     printf("    Handler %s, scheduled at %lu\n",
-           INT_TYPE_NAMES[pend->type], pend->when);
+           INT_TYPE_NAMES[pend.type], pend.when);
 }
 
 /// Print the complete interrupt state -- the status, and all interrupts that
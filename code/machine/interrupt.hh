@@ -36,7 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
-#include "lib/list.hh"
+#include "lib/heap.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -77,6 +77,9 @@ enum IntType {
 class PendingInterrupt {
 public:
 
+    /// Leave the interrupt uninitialized, for storage in the queue.
+    PendingInterrupt() = default;
+
     /// initialize an interrupt that will occur in the future.
     PendingInterrupt(VoidFunctionPtr func, void *param,
                      unsigned long time, IntType kind);
@@ -145,10 +148,20 @@ public:
     /// Advance simulated time.
     void OneTick();
 
+    /// Return how many times `OneTick` can be called, in the current
+    /// machine status, before an interrupt handler has to run or a
+    /// pending context switch has to happen.
+    unsigned long TicksUntilDue() const;
+
+    /// Advance simulated time by `ticks` ticks at once, exactly as that
+    /// many calls to `OneTick` would, as long as they are not more than
+    /// `TicksUntilDue` reports.
+    void AdvanceTicks(unsigned long ticks);
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    Heap<PendingInterrupt> *pending;  ///< The queue of interrupts scheduled
+                                      ///< to occur in the future.
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
@@ -164,7 +177,7 @@ private:
                      IntStatus now);
 
 #ifdef DFS_TICKS_FIX
-    /// Restart total ticks and the pending interrupt list.
+    /// Restart total ticks and the pending interrupt queue.
     void RestartTicks();
 #endif
 
@@ -11,6 +11,10 @@
 #include "machine.hh"
 #include "threads/system.hh"
 
+#ifdef BLOCK_ENGINE
+#include "basic_block.hh"
+#endif
+
 
 static inline bool
 IsExceptionType(ExceptionType t)
@@ -57,6 +61,26 @@ Machine::Machine(SingleStepper *st)
 
     singleStepper = st;
     CheckEndian();
+
+#ifdef BLOCK_ENGINE
+    blocks = new BasicBlock *[MEMORY_SIZE / 4];
+    for (unsigned i = 0; i < MEMORY_SIZE / 4; i++) {
+        blocks[i] = nullptr;
+    }
+#endif
+    inBatch      = false;
+    batchDone    = 0;
+    batchFetches = false;
+}
+
+Machine::~Machine()
+{
+#ifdef BLOCK_ENGINE
+    for (unsigned i = 0; i < MEMORY_SIZE / 4; i++) {
+        delete blocks[i];
+    }
+    delete [] blocks;
+#endif
 }
 
 const int *
@@ -128,6 +152,9 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     DEBUG('m', "Exception: %s\n", ExceptionTypeToString(et));
 
     //ASSERT(interrupt->GetStatus() == USER_MODE);
+    if (inBatch) {
+        FlushBatch();
+    }
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
@@ -48,6 +48,9 @@ enum {
 };
 
 class Instruction;
+#ifdef BLOCK_ENGINE
+class BasicBlock;
+#endif
 
 typedef void (*ExceptionHandler)(ExceptionType);
 
@@ -70,6 +73,9 @@ public:
     /// Initialize the simulation of the hardware for running user programs.
     Machine(SingleStepper *st);
 
+    /// De-allocate the simulation data structures.
+    ~Machine();
+
     /// Routines callable by the Nachos kernel.
 
     /// Run a user program.
@@ -97,10 +103,10 @@ public:
 
     /// Routines internal to the machine simulation -- DO NOT call these.
 
-    /// Fetch one instruction of a user program.
+    /// Fetch one instruction of a user program, already decoded.
     ///
     /// Return false if an exception occurs, true otherwise.
-    bool FetchInstruction(Instruction *instr);
+    bool FetchInstruction(const Instruction **instrPtr);
 
     /// Run a certain instruction of a user program.
     void ExecInstruction(const Instruction *instr);
@@ -108,6 +114,15 @@ public:
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
 
+#ifdef BLOCK_ENGINE
+    /// Run the basic block starting at the current program counter, or as
+    /// much of it as can run before the next interrupt is due.
+    ///
+    /// Return false, without doing anything, if the next instruction has
+    /// to go through the plain interpreter instead.
+    bool RunBlock();
+#endif
+
     /// Trap to the Nachos kernel, because of a system call or other
     /// exception.
     void RaiseException(ExceptionType et, unsigned badVAddr);
@@ -132,6 +147,35 @@ private:
     MMU mmu; ///< Memory management unit.
 
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
+
+#ifdef BLOCK_ENGINE
+    /// Translate the block starting at physical address `physAddr`.
+    BasicBlock *BuildBlock(unsigned physAddr);
+
+    /// Execute the first `count` instructions of `block`.
+    void ExecBlock(BasicBlock *block, unsigned count);
+
+    BasicBlock **blocks;  ///< Translated blocks, indexed by the physical
+                          ///< word where they start.
+#endif
+
+    /// Run as many user instructions as can go by without an interrupt
+    /// becoming due, and credit their ticks all at once.
+    ///
+    /// Return false, without doing anything, if the next instruction has
+    /// to take its tick through `Interrupt::OneTick`.
+    bool RunBatch();
+
+    /// Account for the instructions of the running batch that completed
+    /// before a trap into the kernel.
+    void FlushBatch();
+
+    bool inBatch;  ///< True while user instructions run with their ticks
+                   ///< not yet accounted for.
+    unsigned long batchDone;  ///< Instructions of the batch completed so far.
+    bool batchFetches;  ///< Whether the batch fetched instructions without
+                        ///< going through the MMU, so that the TLB hits
+                        ///< still have to be counted.
 };
 
 
@@ -0,0 +1,494 @@
+/// Basic-block execution engine for user programs.
+///
+/// An alternative to fetching and executing one instruction at a time in
+/// `Machine::Run`, enabled by building with `BLOCK_ENGINE`.  Code is
+/// translated into `BasicBlock`s (see `basic_block.hh`) and each block is
+/// run with threaded dispatch: every operation jumps straight to the
+/// handler of the next one, using GCC's labels-as-values extension.
+///
+/// The engine is exact with respect to the plain interpreter:
+///
+/// * registers, delayed loads and program counters are updated after every
+///   instruction just like `ExecInstruction` does, so a trap in the middle
+///   of a block sees the same state;
+/// * a block only runs as many instructions as `Interrupt::TicksUntilDue`
+///   allows, and their ticks are credited at once with `AdvanceTicks`, so
+///   interrupts fire at the same simulated time; instructions completed
+///   before a trap are credited before the kernel runs;
+/// * instruction fetch statistics are kept as if every instruction had
+///   been fetched through the MMU.
+///
+/// Whenever something needs per-instruction attention (a single stepper, a
+/// branch delay slot pending at the block entry, machine or interrupt
+/// tracing), `RunBlock` declines and `Machine::Run` falls back to the plain
+/// interpreter for one instruction.
+
+
+#ifdef BLOCK_ENGINE
+
+#include "basic_block.hh"
+#include "machine.hh"
+#include "threads/system.hh"
+
+
+/// Return true if `op` transfers control, so that the block ends with the
+/// instruction in its delay slot.
+static bool
+IsControlTransfer(unsigned char op)
+{
+    switch (op) {
+        case OP_BEQ:  case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+        case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+        case OP_J:    case OP_JAL:  case OP_JALR:   case OP_JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Return true if `op` always traps into the kernel.
+static bool
+IsTrap(unsigned char op)
+{
+    return op == OP_SYSCALL || op == OP_RES || op == OP_UNIMP;
+}
+
+bool
+Machine::RunBlock()
+{
+    int pc = registers[PC_REG];
+    if (registers[NEXT_PC_REG] != pc + 4) {
+        return false;  // Entering a delay slot.
+    }
+    if (debug.IsEnabled('m') || debug.IsEnabled('i')
+          || debug.IsEnabled('a')) {
+        return false;
+    }
+
+    unsigned long quiet = interrupt->TicksUntilDue();
+    if (quiet == 0) {
+        return false;
+    }
+
+    unsigned physAddr;
+    if (mmu.TranslateFetch(pc, &physAddr) != NO_EXCEPTION) {
+        return false;  // Let the interpreter raise the exception.
+    }
+
+    BasicBlock *block = blocks[physAddr / 4];
+    if (block == nullptr
+          || block->version != mmu.GetFrameVersion(physAddr / PAGE_SIZE)) {
+        block = BuildBlock(physAddr);
+    }
+
+    unsigned count = block->length;
+    if (quiet < count) {
+        count = quiet;
+    }
+    ExecBlock(block, count);
+    return true;
+}
+
+/// Translate the instructions starting at physical address `physAddr`, up
+/// to the end of the basic block or of the page.
+BasicBlock *
+Machine::BuildBlock(unsigned physAddr)
+{
+    BasicBlock *block = blocks[physAddr / 4];
+    if (block == nullptr) {
+        block = new BasicBlock;
+        blocks[physAddr / 4] = block;
+    }
+
+    unsigned pageEnd = (physAddr / PAGE_SIZE + 1) * PAGE_SIZE;
+    bool delaySlot = false;
+    block->length = 0;
+    for (unsigned addr = physAddr; addr < pageEnd; addr += 4) {
+        const Instruction *instr = mmu.DecodeAt(addr);
+        BlockOp *op = &block->ops[block->length++];
+
+        op->handler = nullptr;  // Linked by `ExecBlock`.
+        op->instr   = *instr;
+        op->rs      = &registers[instr->rs];
+        op->rt      = &registers[instr->rt];
+        op->rd      = &registers[instr->rd];
+        op->extra   = instr->extra;
+        switch (instr->opCode) {
+            case OP_BEQ:  case OP_BGEZ: case OP_BGTZ: case OP_BLEZ:
+            case OP_BLTZ: case OP_BNE:  case OP_J:    case OP_JAL:
+                op->extra = IndexToAddr(instr->extra);
+                break;
+        }
+
+        if (delaySlot || IsTrap(instr->opCode)) {
+            break;
+        }
+        delaySlot = IsControlTransfer(instr->opCode);
+    }
+    block->frame   = physAddr / PAGE_SIZE;
+    block->version = mmu.GetFrameVersion(block->frame);
+    return block;
+}
+
+/// Finish an instruction the same way `ExecInstruction` does: perform the
+/// pending delayed load, schedule the next one, and advance the program
+/// counters.
+#define RETIRE(loadReg, loadValue)                       \
+    do {                                                 \
+        regs[regs[LOAD_REG]]  = regs[LOAD_VALUE_REG];    \
+        regs[LOAD_REG]        = (loadReg);               \
+        regs[LOAD_VALUE_REG]  = (loadValue);             \
+        regs[0]               = 0;                       \
+        regs[PREV_PC_REG]     = regs[PC_REG];            \
+        regs[PC_REG]          = regs[NEXT_PC_REG];       \
+        regs[NEXT_PC_REG]     = pcAfter;                 \
+    } while (0)
+
+/// Go on with the next operation of the block, if any.
+#define NEXT()                                           \
+    do {                                                 \
+        if (++batchDone == count) {                      \
+            goto done;                                   \
+        }                                                \
+        op = &block->ops[batchDone];                     \
+        FETCHED();                                       \
+        pcAfter = regs[NEXT_PC_REG] + 4;                 \
+        goto *op->handler;                               \
+    } while (0)
+
+/// After a store, end the block if it overwrote code of this frame.
+#define NEXT_AFTER_STORE()                                          \
+    do {                                                            \
+        if (mmu.GetFrameVersion(frame) != block->version) {         \
+            count = batchDone + 1;                                  \
+        }                                                           \
+        NEXT();                                                     \
+    } while (0)
+
+#ifdef SWAP
+#define FETCHED()  coreMap->PageUsed(frame)
+#else
+#define FETCHED()  do {} while (0)
+#endif
+
+/// Execute the first `count` operations of `block`.
+///
+/// The caller guarantees that `count` ticks can elapse without any
+/// interrupt becoming due.
+void
+Machine::ExecBlock(BasicBlock *block, unsigned count)
+{
+    static const void *const HANDLERS[MAX_OPCODE + 1] = {
+        &&generic,  // 0
+        &&generic, &&generic, &&op_addiu, &&op_addu, &&op_and,
+        &&op_andi, &&op_beq, &&op_bgez, &&generic, &&op_bgtz,
+        &&op_blez, &&op_bltz, &&generic, &&op_bne, &&generic,
+        &&generic, &&generic, &&op_j, &&op_jal, &&op_jalr,
+        &&op_jr, &&op_lb, &&op_lbu, &&op_lh, &&op_lhu,
+        &&op_lui, &&op_lw, &&generic, &&generic, &&generic,
+        &&op_mfhi, &&op_mflo, &&generic, &&op_mthi, &&op_mtlo,
+        &&generic, &&generic, &&op_nor, &&op_or, &&op_ori,
+        &&generic, &&op_sb, &&op_sh, &&op_sll, &&op_sllv,
+        &&op_slt, &&op_slti, &&op_sltiu, &&op_sltu, &&op_sra,
+        &&op_srav, &&op_srl, &&op_srlv, &&generic, &&op_subu,
+        &&op_sw, &&generic, &&generic, &&op_xor, &&op_xori,
+        &&generic, &&generic, &&generic
+    };
+
+    ASSERT(count > 0 && count <= block->length);
+
+    if (block->ops[0].handler == nullptr) {
+        for (unsigned i = 0; i < block->length; i++) {
+            BlockOp *o = &block->ops[i];
+            ASSERT(o->instr.opCode <= MAX_OPCODE);
+            o->handler = HANDLERS[o->instr.opCode];
+        }
+    }
+
+    int *regs = registers;
+    unsigned frame = block->frame;
+    unsigned value;
+    int tmp;
+    int pcAfter = regs[NEXT_PC_REG] + 4;
+    BlockOp *op = &block->ops[0];
+
+    inBatch      = true;
+    batchDone    = 0;
+    batchFetches = true;
+    goto *op->handler;
+
+op_addiu:
+    *op->rt = *op->rs + op->extra;
+    RETIRE(0, 0);
+    NEXT();
+
+op_addu:
+    *op->rd = *op->rs + *op->rt;
+    RETIRE(0, 0);
+    NEXT();
+
+op_and:
+    *op->rd = *op->rs & *op->rt;
+    RETIRE(0, 0);
+    NEXT();
+
+op_andi:
+    *op->rt = *op->rs & (op->extra & 0xFFFF);
+    RETIRE(0, 0);
+    NEXT();
+
+op_beq:
+    if (*op->rs == *op->rt) {
+        pcAfter = regs[NEXT_PC_REG] + op->extra;
+    }
+    RETIRE(0, 0);
+    NEXT();
+
+op_bgez:
+    if (!(*op->rs & SIGN_BIT)) {
+        pcAfter = regs[NEXT_PC_REG] + op->extra;
+    }
+    RETIRE(0, 0);
+    NEXT();
+
+op_bgtz:
+    if (*op->rs > 0) {
+        pcAfter = regs[NEXT_PC_REG] + op->extra;
+    }
+    RETIRE(0, 0);
+    NEXT();
+
+op_blez:
+    if (*op->rs <= 0) {
+        pcAfter = regs[NEXT_PC_REG] + op->extra;
+    }
+    RETIRE(0, 0);
+    NEXT();
+
+op_bltz:
+    if (*op->rs & SIGN_BIT) {
+        pcAfter = regs[NEXT_PC_REG] + op->extra;
+    }
+    RETIRE(0, 0);
+    NEXT();
+
+op_bne:
+    if (*op->rs != *op->rt) {
+        pcAfter = regs[NEXT_PC_REG] + op->extra;
+    }
+    RETIRE(0, 0);
+    NEXT();
+
+op_jal:
+    regs[RET_ADDR_REG] = regs[NEXT_PC_REG] + 4;
+op_j:
+    pcAfter = (pcAfter & 0xF0000000) | op->extra;
+    RETIRE(0, 0);
+    NEXT();
+
+op_jalr:
+    *op->rd = regs[NEXT_PC_REG] + 4;
+op_jr:
+    pcAfter = *op->rs;
+    RETIRE(0, 0);
+    NEXT();
+
+op_lb:
+op_lbu:
+    if (!ReadMem(*op->rs + op->extra, 1, &tmp)) {
+        goto trapped;
+    }
+    if (tmp & 0x80 && op->instr.opCode == OP_LB) {
+        tmp |= 0xFFFFFF00;
+    } else {
+        tmp &= 0xFF;
+    }
+    RETIRE(op->instr.rt, tmp);
+    NEXT();
+
+op_lh:
+op_lhu:
+    value = *op->rs + op->extra;
+    if (value & 0x1) {
+        RaiseException(ADDRESS_ERROR_EXCEPTION, value);
+        goto trapped;
+    }
+    if (!ReadMem(value, 2, &tmp)) {
+        goto trapped;
+    }
+    if (tmp & 0x8000 && op->instr.opCode == OP_LH) {
+        tmp |= 0xFFFF0000;
+    } else {
+        tmp &= 0xFFFF;
+    }
+    RETIRE(op->instr.rt, tmp);
+    NEXT();
+
+op_lui:
+    *op->rt = op->extra << 16;
+    RETIRE(0, 0);
+    NEXT();
+
+op_lw:
+    value = *op->rs + op->extra;
+    if (value & 0x3) {
+        RaiseException(ADDRESS_ERROR_EXCEPTION, value);
+        goto trapped;
+    }
+    if (!ReadMem(value, 4, &tmp)) {
+        goto trapped;
+    }
+    RETIRE(op->instr.rt, tmp);
+    NEXT();
+
+op_mfhi:
+    *op->rd = regs[HI_REG];
+    RETIRE(0, 0);
+    NEXT();
+
+op_mflo:
+    *op->rd = regs[LO_REG];
+    RETIRE(0, 0);
+    NEXT();
+
+op_mthi:
+    regs[HI_REG] = *op->rs;
+    RETIRE(0, 0);
+    NEXT();
+
+op_mtlo:
+    regs[LO_REG] = *op->rs;
+    RETIRE(0, 0);
+    NEXT();
+
+op_nor:
+    *op->rd = ~(*op->rs | *op->rt);
+    RETIRE(0, 0);
+    NEXT();
+
+op_or:
+    *op->rd = *op->rs | *op->rt;
+    RETIRE(0, 0);
+    NEXT();
+
+op_ori:
+    *op->rt = *op->rs | (op->extra & 0xFFFF);
+    RETIRE(0, 0);
+    NEXT();
+
+op_sb:
+    if (!WriteMem((unsigned) (*op->rs + op->extra), 1, *op->rt)) {
+        goto trapped;
+    }
+    RETIRE(0, 0);
+    NEXT_AFTER_STORE();
+
+op_sh:
+    if (!WriteMem((unsigned) (*op->rs + op->extra), 2, *op->rt)) {
+        goto trapped;
+    }
+    RETIRE(0, 0);
+    NEXT_AFTER_STORE();
+
+op_sll:
+    *op->rd = *op->rt << op->extra;
+    RETIRE(0, 0);
+    NEXT();
+
+op_sllv:
+    *op->rd = *op->rt << (*op->rs & 0x1F);
+    RETIRE(0, 0);
+    NEXT();
+
+op_slt:
+    *op->rd = (*op->rs < *op->rt) ? 1 : 0;
+    RETIRE(0, 0);
+    NEXT();
+
+op_slti:
+    *op->rt = (*op->rs < op->extra) ? 1 : 0;
+    RETIRE(0, 0);
+    NEXT();
+
+op_sltiu:
+    *op->rt = ((unsigned) *op->rs < (unsigned) op->extra) ? 1 : 0;
+    RETIRE(0, 0);
+    NEXT();
+
+op_sltu:
+    *op->rd = ((unsigned) *op->rs < (unsigned) *op->rt) ? 1 : 0;
+    RETIRE(0, 0);
+    NEXT();
+
+op_sra:
+    *op->rd = *op->rt >> op->extra;
+    RETIRE(0, 0);
+    NEXT();
+
+op_srav:
+    *op->rd = *op->rt >> (*op->rs & 0x1F);
+    RETIRE(0, 0);
+    NEXT();
+
+op_srl:
+    // Same as the interpreter, which shifts a signed value.
+    tmp = *op->rt;
+    tmp >>= op->extra;
+    *op->rd = tmp;
+    RETIRE(0, 0);
+    NEXT();
+
+op_srlv:
+    tmp = *op->rt;
+    tmp >>= *op->rs & 0x1F;
+    *op->rd = tmp;
+    RETIRE(0, 0);
+    NEXT();
+
+op_subu:
+    *op->rd = *op->rs - *op->rt;
+    RETIRE(0, 0);
+    NEXT();
+
+op_sw:
+    if (!WriteMem((unsigned) (*op->rs + op->extra), 4, *op->rt)) {
+        goto trapped;
+    }
+    RETIRE(0, 0);
+    NEXT_AFTER_STORE();
+
+op_xor:
+    *op->rd = *op->rs ^ *op->rt;
+    RETIRE(0, 0);
+    NEXT();
+
+op_xori:
+    *op->rt = *op->rs ^ (op->extra & 0xFFFF);
+    RETIRE(0, 0);
+    NEXT();
+
+generic:
+    // Everything else is rare enough to go through the interpreter, which
+    // also takes care of retiring the instruction.
+    ExecInstruction(&op->instr);
+    if (!inBatch) {
+        goto trapped;
+    }
+    NEXT_AFTER_STORE();
+
+trapped:
+    // `RaiseException` already accounted for the instructions before this
+    // one; the one that trapped takes its tick like in `Machine::Run`.
+    ASSERT(!inBatch);
+    interrupt->OneTick();
+    return;
+
+done:
+    inBatch = false;
+    interrupt->AdvanceTicks(count);
+    if (mmu.tlb != nullptr) {
+        stats->numPageHits += count - 1;
+    }
+}
+
+#endif
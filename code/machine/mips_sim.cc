@@ -27,8 +27,8 @@
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;
-      // Storage for decoded instruction.
+    const Instruction *instr;
+      // Decoded instruction, owned by the MMU.
 
     if (debug.IsEnabled('m')) {
         printf("Starting to run at time %lu\n", stats->totalTicks);
@@ -36,7 +36,15 @@ Machine::Run()
     interrupt->SetStatus(USER_MODE);
 
     for (;;) {
-        if (FetchInstruction(instr)) {
+#ifdef BLOCK_ENGINE
+        if (singleStepper == nullptr && RunBlock()) {
+            continue;
+        }
+#endif
+        if (singleStepper == nullptr && RunBatch()) {
+            continue;
+        }
+        if (FetchInstruction(&instr)) {
             ExecInstruction(instr);
         }
         interrupt->OneTick();
@@ -46,6 +54,55 @@ Machine::Run()
     }
 }
 
+bool
+Machine::RunBatch()
+{
+    // Tracing ticks needs every one of them to go through `OneTick`.
+    if (debug.IsEnabled('i')) {
+        return false;
+    }
+    unsigned long quiet = interrupt->TicksUntilDue();
+    if (quiet == 0) {
+        return false;
+    }
+
+    const Instruction *instr;
+    inBatch      = true;
+    batchDone    = 0;
+    batchFetches = false;
+    for (; batchDone < quiet; batchDone++) {
+        if (!FetchInstruction(&instr)) {
+            break;
+        }
+        ExecInstruction(instr);
+        if (!inBatch) {
+            break;
+        }
+    }
+
+    if (inBatch) {
+        inBatch = false;
+        interrupt->AdvanceTicks(batchDone);
+    } else {
+        // `RaiseException` already accounted for the instructions before
+        // the one that trapped, which takes its tick like in `Run`.
+        interrupt->OneTick();
+    }
+    return true;
+}
+
+void
+Machine::FlushBatch()
+{
+    ASSERT(inBatch);
+
+    interrupt->AdvanceTicks(batchDone);
+    if (batchFetches && mmu.tlb != nullptr) {
+        stats->numPageHits += batchDone;
+    }
+    inBatch = false;
+}
+
 /// Simulate effects of a delayed load.
 ///
 /// NOTE -- `RaiseException`/`CheckInterrupts` must also call `DelayedLoad`,
@@ -60,16 +117,16 @@ Machine::DelayedLoad(unsigned nextReg, int nextValue)
 }
 
 bool
-Machine::FetchInstruction(Instruction *instr)
+Machine::FetchInstruction(const Instruction **instrPtr)
 {
-    ASSERT(instr != nullptr);
+    ASSERT(instrPtr != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    ExceptionType e = mmu.FetchInstruction(registers[PC_REG], instrPtr);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
+    const Instruction *instr = *instrPtr;
 
     if (debug.IsEnabled('m')) {
         const struct OpString *str = &OP_STRINGS[instr->opCode];
@@ -9,16 +9,20 @@
 /// table, to find the physical page #.
 ///
 /// Translation lookaside buffer -- associative lookup in the table to find
-/// an entry with the same virtual page #.  If found, this entry is used for
-/// the translation.  If not, it traps to software with an exception.
+/// an entry with the same virtual page # and address space identifier.  If
+/// found, this entry is used for the translation.  If not, it traps to
+/// software with an exception.  The associative lookup is simulated with a
+/// hash table, which the kernel keeps up to date by calling
+/// `LoadedTlbEntry`.
 ///
 /// In practice, the TLB is much smaller than the amount of physical memory
 /// (16 entries is common on a machine that has 1000's of pages).  Thus,
 /// there must also be a backup translation scheme (such as page tables), but
 /// the hardware does not need to know anything at all about that.
 ///
-/// Note that the contents of the TLB are specific to an address space.
-/// If the address space changes, so does the contents of the TLB!
+/// Note that the contents of the TLB are specific to an address space:
+/// entries are tagged with the identifier of their address space, and only
+/// those of the space in `asid` are used.
 ///
 /// DO NOT CHANGE -- part of the machine emulation
 ///
@@ -35,18 +39,37 @@
 #include <stdio.h>
 
 
+static_assert(PAGE_SIZE / 4 <= sizeof (unsigned) * 8,
+              "decoded instruction mask must hold a bit per word of a page");
+
 MMU::MMU()
 {
     mainMemory = new char [MEMORY_SIZE];
     for (unsigned i = 0; i < MEMORY_SIZE; i++) {
         mainMemory[i] = 0;
     }
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        decodedMask[i]  = 0;
+        frameVersion[i] = 0;
+    }
+    fetchEntry = nullptr;
+    dataEntry  = nullptr;
+    asid       = 0;
+    tlbUses    = 0;
 
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLB_SIZE];
     for (unsigned i = 0; i < TLB_SIZE; i++) {
         tlb[i].valid = false;
     }
+    for (unsigned b = 0; b < TLB_BUCKETS; b++) {
+        tlbBuckets[b] = NO_TLB_ENTRY;
+    }
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        tlbNext[i] = tlbPrev[i] = NO_TLB_ENTRY;
+        tlbBucketOf[i] = TLB_BUCKETS;
+        tlbLastUse[i] = 0;
+    }
     pageTable = nullptr;
 #else  // Use linear page table.
     tlb = nullptr;
@@ -69,8 +92,9 @@ MMU::PrintTLB() const
     printf("TLB content (%u entries):\n", TLB_SIZE);
     for (unsigned i = 0; i < TLB_SIZE; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d,"
+               " flags: %s%s%s\n",
+               i, e->valid, e->asid, e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
                (e->dirty)    ? "dirty" : "");
@@ -80,6 +104,65 @@ MMU::PrintTLB() const
 #endif
 }
 
+unsigned
+MMU::TlbBucket(unsigned vpn, unsigned asid)
+{
+    return (vpn ^ asid * 0x9E3779B1U) % TLB_BUCKETS;
+}
+
+void
+MMU::LoadedTlbEntry(unsigned i)
+{
+    ASSERT(tlb != nullptr);
+    ASSERT(i < TLB_SIZE);
+
+    // Unchain the entry from where it was.
+    if (tlbBucketOf[i] != TLB_BUCKETS) {
+        if (tlbPrev[i] != NO_TLB_ENTRY) {
+            tlbNext[tlbPrev[i]] = tlbNext[i];
+        } else {
+            tlbBuckets[tlbBucketOf[i]] = tlbNext[i];
+        }
+        if (tlbNext[i] != NO_TLB_ENTRY) {
+            tlbPrev[tlbNext[i]] = tlbPrev[i];
+        }
+    }
+
+    // And chain it at the front of its new bucket.
+    unsigned b = TlbBucket(tlb[i].virtualPage, tlb[i].asid);
+    tlbBucketOf[i] = b;
+    tlbPrev[i] = NO_TLB_ENTRY;
+    tlbNext[i] = tlbBuckets[b];
+    if (tlbNext[i] != NO_TLB_ENTRY) {
+        tlbPrev[tlbNext[i]] = i;
+    }
+    tlbBuckets[b] = i;
+    tlbLastUse[i] = ++tlbUses;
+}
+
+int
+MMU::FindTlbEntry(unsigned vpn, unsigned space) const
+{
+    ASSERT(tlb != nullptr);
+
+    for (unsigned i = tlbBuckets[TlbBucket(vpn, space)]; i != NO_TLB_ENTRY;
+           i = tlbNext[i]) {
+        const TranslationEntry *e = &tlb[i];
+        if (e->valid && e->virtualPage == vpn && e->asid == space) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+unsigned long
+MMU::GetTlbLastUse(unsigned i) const
+{
+    ASSERT(i < TLB_SIZE);
+
+    return tlbLastUse[i];
+}
+
 /// Read `size` (1, 2, or 4) bytes of virtual memory at `addr` into
 /// the location pointed to by `value`.
 ///
@@ -94,12 +177,15 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 {
     ASSERT(value != nullptr);
 
-    DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
-
     unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, false);
-    if (e != NO_EXCEPTION) {
-        return e;
+    if (!QuickTranslate(addr, size, false, dataEntry, &physicalAddress)) {
+        DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
+
+        ExceptionType e = SlowTranslate(addr, &physicalAddress, size, false,
+                                        &dataEntry);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
     }
 
     int data;
@@ -139,12 +225,25 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 ExceptionType
 MMU::WriteMem(unsigned addr, unsigned size, int value)
 {
-    DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
-
     unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, true);
-    if (e != NO_EXCEPTION) {
-        return e;
+    if (!QuickTranslate(addr, size, true, dataEntry, &physicalAddress)) {
+        DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n",
+              addr, size, value);
+
+        ExceptionType e = SlowTranslate(addr, &physicalAddress, size, true,
+                                        &dataEntry);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+    }
+
+    // The word may hold a cached instruction (self-modifying code, or a
+    // frame reused for data); drop it.
+    unsigned frame = physicalAddress / PAGE_SIZE;
+    unsigned bit   = 1U << (physicalAddress % PAGE_SIZE / 4);
+    if (decodedMask[frame] & bit) {
+        decodedMask[frame] &= ~bit;
+        frameVersion[frame]++;
     }
 
     switch (size) {
@@ -171,7 +270,164 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
 }
 
 ExceptionType
-MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
+MMU::TranslatePage(unsigned addr, bool writing, unsigned *physAddr)
+{
+    ASSERT(physAddr != nullptr);
+
+    DEBUG('a', "%s VA 0x%X for the kernel\n",
+          writing ? "Writing" : "Reading", addr);
+
+    ExceptionType e = Translate(addr, physAddr, 1, writing);
+    if (e == NO_EXCEPTION && writing) {
+        unsigned frame = *physAddr / PAGE_SIZE;
+        if (decodedMask[frame] != 0) {
+            InvalidateFrame(frame);
+        }
+    }
+    return e;
+}
+
+/// Fetch the instruction word at virtual address `addr` and return it
+/// decoded in `*instr`.
+///
+/// Behaves exactly like `ReadMem(addr, 4, ...)` followed by
+/// `Instruction::Decode`, including the use bit and the statistics, but
+/// skips decoding when the word has not changed since it was last decoded.
+///
+/// * `addr` is the virtual address of the instruction.
+/// * `instr` is where to store a pointer to the decoded instruction.
+ExceptionType
+MMU::FetchInstruction(unsigned addr, const Instruction **instr)
+{
+    ASSERT(instr != nullptr);
+
+    unsigned physicalAddress;
+    ExceptionType e = TranslateFetch(addr, &physicalAddress);
+    if (e != NO_EXCEPTION) {
+        return e;
+    }
+    *instr = DecodeAt(physicalAddress);
+    if (debug.IsEnabled('a')) {
+        DEBUG('a', "\tValue read: %8.8X\n", (*instr)->value);
+    }
+    return NO_EXCEPTION;
+}
+
+/// Translate the virtual address `addr` of an instruction into
+/// `*physAddr`.
+///
+/// Consecutive fetches from the same page reuse the last TLB entry instead
+/// of searching the TLB again (page tables are indexed directly anyway).
+ExceptionType
+MMU::TranslateFetch(unsigned addr, unsigned *physAddr)
+{
+    ASSERT(physAddr != nullptr);
+
+    if (QuickTranslate(addr, 4, false, fetchEntry, physAddr)) {
+        return NO_EXCEPTION;
+    }
+
+    DEBUG('a', "Reading VA 0x%X, size %u\n", addr, 4);
+    return SlowTranslate(addr, physAddr, 4, false, &fetchEntry);
+}
+
+/// Try to translate `addr` without going through `Translate`, for an
+/// access of `size` bytes.
+///
+/// With a TLB, only `last` (the entry used by the previous access of the
+/// same kind) is tried; with a page table, the entry is indexed directly.
+/// The use and dirty bits, the coremap and the statistics are updated like
+/// `Translate` does.  Any unusual case (misalignment, a miss, a write to a
+/// read-only page, tracing of address translation) returns false and must
+/// be retried with `Translate`.
+bool
+MMU::QuickTranslate(unsigned addr, unsigned size, bool writing,
+                    TranslationEntry *last, unsigned *physAddr)
+{
+    if ((addr & (size - 1)) != 0 || debug.IsEnabled('a')) {
+        return false;
+    }
+
+    unsigned vpn = addr / PAGE_SIZE;
+    TranslationEntry *entry;
+    if (tlb == nullptr) {
+        if (vpn >= pageTableSize || !pageTable[vpn].valid) {
+            return false;
+        }
+        entry = &pageTable[vpn];
+    } else {
+        if (last == nullptr || !last->valid || last->virtualPage != vpn
+              || last->asid != asid) {
+            return false;
+        }
+        entry = last;
+    }
+    if (entry->physicalPage >= NUM_PHYS_PAGES
+          || (writing && entry->readOnly)) {
+        return false;
+    }
+
+    if (tlb != nullptr) {
+        tlbLastUse[entry - tlb] = ++tlbUses;
+#ifdef SWAP
+        coreMap->PageUsed(entry->physicalPage);
+#endif
+        stats->numPageHits++;
+    }
+    entry->use = true;
+    if (writing) {
+        entry->dirty = true;
+    }
+    *physAddr = entry->physicalPage * PAGE_SIZE + addr % PAGE_SIZE;
+    return true;
+}
+
+/// Translate `addr` with `Translate`, and remember the TLB entry used in
+/// `*last` for the next `QuickTranslate`.
+ExceptionType
+MMU::SlowTranslate(unsigned addr, unsigned *physAddr, unsigned size,
+                   bool writing, TranslationEntry **last)
+{
+    TranslationEntry *entry;
+    ExceptionType e = Translate(addr, physAddr, size, writing, &entry);
+    if (e == NO_EXCEPTION && tlb != nullptr) {
+        *last = entry;
+    }
+    return e;
+}
+
+const Instruction *
+MMU::DecodeAt(unsigned physAddr)
+{
+    ASSERT(physAddr < MEMORY_SIZE && (physAddr & 0x3) == 0);
+
+    unsigned frame = physAddr / PAGE_SIZE;
+    unsigned word  = physAddr % PAGE_SIZE / 4;
+    Instruction *cached = &decoded[frame][word];
+    if (!(decodedMask[frame] & 1U << word)) {
+        cached->value = WordToHost(*(unsigned *) &mainMemory[physAddr]);
+        cached->Decode();
+        decodedMask[frame] |= 1U << word;
+    }
+    return cached;
+}
+
+unsigned
+MMU::GetFrameVersion(unsigned frame) const
+{
+    return frameVersion[frame];
+}
+
+void
+MMU::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < NUM_PHYS_PAGES);
+    decodedMask[frame] = 0;
+    frameVersion[frame]++;
+}
+
+ExceptionType
+MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry)
 {
     ASSERT(entry != nullptr);
 
@@ -197,11 +453,13 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
         // Use the TLB.
 
         unsigned i;
-        for (i = 0; i < TLB_SIZE; i++) {
+        for (i = tlbBuckets[TlbBucket(vpn, asid)]; i != NO_TLB_ENTRY;
+               i = tlbNext[i]) {
             TranslationEntry *e = &tlb[i];
-            if (e->valid && e->virtualPage == vpn) {
+            if (e->valid && e->virtualPage == vpn && e->asid == asid) {
                 *entry = e;  // FOUND!
-                #ifdef POLICY_LRU
+                tlbLastUse[i] = ++tlbUses;
+                #ifdef SWAP
                 coreMap->PageUsed(e->physicalPage);
                 #endif
                 stats->numPageHits++;
@@ -229,9 +487,10 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 /// * `physAddr" is the place to store the physical address.
 /// * `size" is the amount of memory being read or written.
 /// * `writing` -- if true, check the “read-only” bit in the TLB.
+/// * `entryPtr`, if not null, is where to store the translation entry used.
 ExceptionType
 MMU::Translate(unsigned virtAddr, unsigned *physAddr,
-               unsigned size, bool writing)
+               unsigned size, bool writing, TranslationEntry **entryPtr)
 {
     ASSERT(physAddr != nullptr);
     // We must have either a TLB or a page table, but not both!
@@ -280,6 +539,9 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 
     *physAddr = pageFrame * PAGE_SIZE + offset;
     ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
+    if (entryPtr != nullptr) {
+        *entryPtr = entry;
+    }
     DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
     return NO_EXCEPTION;
 }
@@ -11,6 +11,7 @@
 
 #include "exception_type.hh"
 #include "disk.hh"
+#include "instruction.hh"
 #include "translation_entry.hh"
 
 
@@ -45,8 +46,63 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Translate virtual address `addr` for the kernel, with the same
+    /// checks and side effects as a 1-byte `ReadMem` or `WriteMem`, and
+    /// store the physical address in `*physAddr`.
+    ///
+    /// The rest of the page can then be read or written directly through
+    /// `mainMemory`.  For a write, the decoded instructions of the frame are
+    /// dropped.
+    ExceptionType TranslatePage(unsigned addr, bool writing,
+                                unsigned *physAddr);
+
+    /// Fetch the instruction at virtual address `addr`, already decoded.
+    ///
+    /// Decoded instructions are cached per physical frame, so that hot
+    /// loops skip both translation and decoding.  The returned pointer is
+    /// only valid until the next memory operation.
+    ExceptionType FetchInstruction(unsigned addr, const Instruction **instr);
+
+    /// Translate the address of an instruction fetch, with the same side
+    /// effects as a 4-byte `ReadMem`.
+    ExceptionType TranslateFetch(unsigned addr, unsigned *physAddr);
+
+    /// Return the decoded instruction stored at physical address
+    /// `physAddr`, decoding it if it is not cached yet.
+    const Instruction *DecodeAt(unsigned physAddr);
+
+    /// Return a counter that changes every time a cached instruction of
+    /// frame `frame` is invalidated.
+    unsigned GetFrameVersion(unsigned frame) const;
+
+    /// Forget every decoded instruction cached for physical frame `frame`.
+    ///
+    /// Must be called by the kernel whenever it changes the contents of a
+    /// frame directly through `mainMemory` (loading a page from the
+    /// executable or from swap, or handing the frame to another page).
+    void InvalidateFrame(unsigned frame);
+
     void PrintTLB() const;
 
+    /// Tell the MMU that the kernel stored a translation into TLB entry
+    /// `i`.
+    ///
+    /// Must be called every time the virtual page or the address space of
+    /// an entry is written, so that the entry can be found again; clearing
+    /// the `valid` bit needs no call.
+    void LoadedTlbEntry(unsigned i);
+
+    /// Return the valid TLB entry that translates virtual page `vpn` of
+    /// address space `space`, or -1 if there is none.
+    ///
+    /// Lookups go through the same hash table as translations, and do not
+    /// count as TLB hits.
+    int FindTlbEntry(unsigned vpn, unsigned space) const;
+
+    /// Return when TLB entry `i` was last used, as a counter that grows
+    /// with every TLB hit; only the order between entries is meaningful.
+    unsigned long GetTlbLastUse(unsigned i) const;
+
     /// Data structures -- all of these are accessible to Nachos kernel code.
     /// “Public” for convenience.
     ///
@@ -82,11 +138,14 @@ public:
     TranslationEntry *pageTable;
     unsigned pageTableSize;
 
+    unsigned asid;  ///< Address space identifier of the running program;
+                    ///< only TLB entries tagged with it are used.
+
 private:
 
     /// Retrieve a page entry either from a page table or the TLB.
     ExceptionType RetrievePageEntry(unsigned vpn,
-                                    TranslationEntry **entry) const;
+                                    TranslationEntry **entry);
 
     /// Translate an address, and check for alignment.
     ///
@@ -94,7 +153,54 @@ private:
     /// and return an exception code if the translation could not be
     /// completed.
     ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
-                            unsigned size, bool writing);
+                            unsigned size, bool writing,
+                            TranslationEntry **entryPtr = nullptr);
+
+    /// Number of instruction words in a page.
+    static const unsigned WORDS_PER_PAGE = PAGE_SIZE / 4;
+
+    /// Decoded instructions, one slot per word of physical memory.
+    Instruction decoded[NUM_PHYS_PAGES][WORDS_PER_PAGE];
+
+    /// One bit per slot in `decoded`, set while the slot is up to date.
+    unsigned decodedMask[NUM_PHYS_PAGES];
+
+    /// Bumped whenever a frame loses cached instructions.
+    unsigned frameVersion[NUM_PHYS_PAGES];
+
+    /// Translate without searching the TLB, when possible.
+    bool QuickTranslate(unsigned addr, unsigned size, bool writing,
+                        TranslationEntry *last, unsigned *physAddr);
+
+    /// Translate through `Translate`, remembering the TLB entry used.
+    ExceptionType SlowTranslate(unsigned addr, unsigned *physAddr,
+                                unsigned size, bool writing,
+                                TranslationEntry **last);
+
+    /// TLB entries used by the last instruction fetch and the last data
+    /// access, so that consecutive accesses to the same page avoid the TLB
+    /// lookup.
+    TranslationEntry *fetchEntry;
+    TranslationEntry *dataEntry;
+
+    /// Hash table over the TLB, keyed by virtual page and address space, so
+    /// that lookups do not depend on `TLB_SIZE`.
+    ///
+    /// Entries of a bucket are chained through `tlbNext` and `tlbPrev`;
+    /// `NO_TLB_ENTRY` ends a chain.
+    static const unsigned TLB_BUCKETS = 2 * TLB_SIZE;
+    static const unsigned NO_TLB_ENTRY = TLB_SIZE;
+    unsigned tlbBuckets[TLB_BUCKETS];
+    unsigned tlbNext[TLB_SIZE];
+    unsigned tlbPrev[TLB_SIZE];
+    unsigned tlbBucketOf[TLB_SIZE];  ///< Bucket each entry is chained in,
+                                     ///< or `TLB_BUCKETS` if none yet.
+
+    static unsigned TlbBucket(unsigned vpn, unsigned asid);
+
+    /// Value of `tlbUses` at the last hit of each TLB entry.
+    unsigned long tlbLastUse[TLB_SIZE];
+    unsigned long tlbUses;  ///< Number of TLB hits and loads so far.
 };
 
 
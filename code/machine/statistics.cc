@@ -22,6 +22,32 @@ Statistics::Statistics()
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPacketsSent = numPacketsRecvd = 0;
     numPageFaults = numPageHits = 0;
+#ifdef USE_TLB
+    for (unsigned i = 0; i < MAX_SPACES; i++) {
+        spaceTlbHits[i] = spaceTlbMisses[i] = 0;
+    }
+    firstRetired = lastRetired = nullptr;
+    tlbPolicyName = "";
+    numTlbEvictions = numTlbEntriesExamined = 0;
+#endif
+#ifdef SWAP
+    pageReplacementName = "";
+    numPageLoads = numPageEvictions = numSwapReads = numSwapWrites = 0;
+    numPageoutWrites = numPageoutTransfers = swapTicks = 0;
+    numPagesPrefetched = numSharedCodePages = 0;
+    numCopyOnWriteFaults = numCopyOnWriteCopies = numZeroPageMaps = 0;
+    for (unsigned i = 0; i < FAULT_TIME_BUCKETS; i++) {
+        faultServiceTime[i] = 0;
+    }
+#endif
+#ifdef FILESYS
+    numSectorCacheHits = numSectorCacheMisses = 0;
+    numSectorCacheReadHits = 0;
+    numSectorCacheWriteBacks = numSectorCacheWritesAbsorbed = 0;
+    numSectorsReadAhead = numSectorsReadAheadUsed = 0;
+    diskSchedulingName = "";
+    numDiskRequests = numDiskRequestsQueued = diskRequestTicks = 0;
+#endif
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
@@ -45,11 +71,109 @@ Statistics::Print()
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
 #ifdef USE_TLB
-    double hitRatio = (((double)numPageHits - (double)numPageFaults) / ((double)numPageHits)) * 100;
+    double hitRatio = numPageHits == 0 ? 0.0
+      : (((double)numPageHits - (double)numPageFaults) / ((double)numPageHits)) * 100;
     printf("Paging: faults %lu, hits %lu, hit ratio %% %.2lf\n", numPageFaults, numPageHits, hitRatio);
+    printf("TLB: policy %s, miss rate %% %.2lf, evictions %lu,"
+           " entries examined per refill %.2lf\n",
+           tlbPolicyName,
+           numPageHits == 0 ? 0.0 : numPageFaults * 100.0 / numPageHits,
+           numTlbEvictions,
+           numPageFaults == 0 ? 0.0
+                              : (double) numTlbEntriesExamined / numPageFaults);
+    for (RetiredSpace *r = firstRetired; r != nullptr; r = r->next) {
+        printf("    address space id %u, destroyed: TLB hits %lu,"
+               " misses %lu\n", r->asid, r->tlbHits, r->tlbMisses);
+    }
+    for (unsigned i = 0; i < MAX_SPACES; i++) {
+        if (spaceTlbHits[i] != 0 || spaceTlbMisses[i] != 0) {
+            printf("    address space id %u: TLB hits %lu, misses %lu\n",
+                   i, spaceTlbHits[i], spaceTlbMisses[i]);
+        }
+    }
 #else
     printf("Paging: faults %lu\n", numPageFaults);
+#endif
+#ifdef SWAP
+    printf("Memory: policy %s, page faults %lu, pages brought in ahead"
+           " %lu, evictions %lu, swap reads %lu, swap writes %lu\n",
+           pageReplacementName, numPageLoads, numPagesPrefetched,
+           numPageEvictions, numSwapReads, numSwapWrites);
+    printf("Pageout: %lu pages cleaned in %lu transfers\n",
+           numPageoutWrites, numPageoutTransfers);
+    printf("Shared code pages: %lu faults served without loading\n",
+           numSharedCodePages);
+    printf("Copy-on-write: %lu faults, %lu pages copied\n",
+           numCopyOnWriteFaults, numCopyOnWriteCopies);
+    printf("Zero page: %lu faults served by mapping it\n", numZeroPageMaps);
+    if (numPageLoads != 0) {
+        // Only a few buckets are hit, as transfers take fixed times.
+        printf("Page fault service time (ticks of swap transfers):\n");
+        for (unsigned i = 0; i < FAULT_TIME_BUCKETS; i++) {
+            if (faultServiceTime[i] == 0) {
+                continue;
+            }
+            if (i + 1 == FAULT_TIME_BUCKETS) {
+                printf("    >= %6lu: %lu\n",
+                       1UL << (i - 1), faultServiceTime[i]);
+            } else {
+                printf("    <  %6lu: %lu\n", 1UL << i, faultServiceTime[i]);
+            }
+        }
+    }
+#endif
+#ifdef FILESYS
+    unsigned long lookups = numSectorCacheHits + numSectorCacheMisses;
+    printf("Sector cache: hits %lu, misses %lu, hit ratio %% %.2lf,"
+           " write-backs %lu, disk operations saved %lu\n",
+           numSectorCacheHits, numSectorCacheMisses,
+           lookups == 0 ? 0.0 : numSectorCacheHits * 100.0 / lookups,
+           numSectorCacheWriteBacks,
+           numSectorCacheReadHits + numSectorCacheWritesAbsorbed);
+    printf("Read-ahead: %lu sectors read, %lu used\n",
+           numSectorsReadAhead, numSectorsReadAheadUsed);
+    printf("Disk scheduling: policy %s, requests %lu, queued %lu,"
+           " mean latency %.1lf ticks\n",
+           diskSchedulingName, numDiskRequests, numDiskRequestsQueued,
+           numDiskRequests == 0 ? 0.0
+                                : (double) diskRequestTicks / numDiskRequests);
 #endif
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
 }
+
+#ifdef USE_TLB
+void
+Statistics::RetireSpace(unsigned asid)
+{
+    ASSERT(asid < MAX_SPACES);
+
+    RetiredSpace *r = new RetiredSpace;
+    r->asid = asid;
+    r->tlbHits = spaceTlbHits[asid];
+    r->tlbMisses = spaceTlbMisses[asid];
+    r->next = nullptr;
+    if (lastRetired == nullptr) {
+        firstRetired = r;
+    } else {
+        lastRetired->next = r;
+    }
+    lastRetired = r;
+    spaceTlbHits[asid] = spaceTlbMisses[asid] = 0;
+}
+#endif
+
+#ifdef SWAP
+void
+Statistics::RecordFaultServiceTime(unsigned long ticks)
+{
+    unsigned bucket = 0;
+    for (; ticks != 0; ticks >>= 1) {
+        bucket++;
+    }
+    if (bucket >= FAULT_TIME_BUCKETS) {
+        bucket = FAULT_TIME_BUCKETS - 1;
+    }
+    faultServiceTime[bucket]++;
+}
+#endif
@@ -50,6 +50,127 @@ public:
     /// Number of virtual memory page hits.
     unsigned long numPageHits;
 
+    /// Number of address space identifiers, which bounds how many address
+    /// spaces can be alive at once.
+    static const unsigned MAX_SPACES = 64;
+
+#ifdef USE_TLB
+    /// TLB hits of the address space that has each identifier.
+    ///
+    /// Identifiers are reused, so the counts are moved aside by
+    /// `RetireSpace` when their address space is destroyed.
+    unsigned long spaceTlbHits[MAX_SPACES];
+
+    /// TLB misses of the address space that has each identifier.
+    unsigned long spaceTlbMisses[MAX_SPACES];
+
+    /// Keep the TLB hits and misses of the address space with identifier
+    /// `asid` for `Print`, and reset them for the next space to get it.
+    void RetireSpace(unsigned asid);
+
+    /// Name of the TLB replacement policy.
+    const char *tlbPolicyName;
+
+    /// Number of valid TLB entries replaced to make room for others.
+    unsigned long numTlbEvictions;
+
+    /// Number of TLB entries looked at by the replacement policy, which
+    /// measures the cost of its decisions.
+    unsigned long numTlbEntriesExamined;
+#endif
+
+#ifdef SWAP
+    /// Name of the page replacement policy.
+    const char *pageReplacementName;
+
+    /// Number of faults on pages that were not in memory, which had to be
+    /// loaded from the executable or from swap.
+    unsigned long numPageLoads;
+
+    /// Number of pages brought in ahead of a fault on a neighbouring page.
+    unsigned long numPagesPrefetched;
+
+    /// Number of code page faults served by mapping a frame that another
+    /// address space running the same executable had already loaded.
+    unsigned long numSharedCodePages;
+
+    /// Number of writes to pages shared by `Fork` or mapped to the zero
+    /// frame, and how many of them had to copy the page because it was
+    /// still shared.
+    unsigned long numCopyOnWriteFaults;
+    unsigned long numCopyOnWriteCopies;
+
+    /// Number of faults on pages never written to, served by mapping the
+    /// shared zero frame.
+    unsigned long numZeroPageMaps;
+
+    /// Number of pages evicted to free a frame.
+    unsigned long numPageEvictions;
+
+    /// Number of pages read from swap.
+    unsigned long numSwapReads;
+
+    /// Number of evicted pages that had to be written to swap.
+    unsigned long numSwapWrites;
+
+    /// Number of dirty pages written to swap by the pageout daemon, which
+    /// leaves them mapped, and number of transfers it took.
+    unsigned long numPageoutWrites;
+    unsigned long numPageoutTransfers;
+
+    /// Time the swap area spent transferring pages, as modelled by
+    /// `SWAP_TIME`.  Swap transfers do not advance the simulated clock.
+    unsigned long swapTicks;
+
+    /// Number of buckets in `faultServiceTime`.
+    static const unsigned FAULT_TIME_BUCKETS = 18;
+
+    /// Histogram of the swap time taken to bring faulting pages into
+    /// memory, including writing back the page evicted for them, but not
+    /// the pages brought in ahead.
+    ///
+    /// Bucket 0 counts the faults that needed no swap transfer, and bucket
+    /// `i` those that took from 2^(i-1) to 2^i ticks; the last one also
+    /// counts any slower fault.
+    unsigned long faultServiceTime[FAULT_TIME_BUCKETS];
+
+    /// Record that bringing a page into memory took `ticks` of swap time.
+    void RecordFaultServiceTime(unsigned long ticks);
+#endif
+
+#ifdef FILESYS
+    /// Number of sector reads and writes that found the sector in the
+    /// sector cache, and that did not.
+    unsigned long numSectorCacheHits;
+    unsigned long numSectorCacheMisses;
+
+    /// Number of sector reads that found the sector in the sector cache,
+    /// each of which saved a disk read.
+    unsigned long numSectorCacheReadHits;
+
+    /// Number of dirty sectors written back to disk by the sector cache.
+    unsigned long numSectorCacheWriteBacks;
+
+    /// Number of writes to sectors that were still dirty, which cost no
+    /// disk write of their own.
+    unsigned long numSectorCacheWritesAbsorbed;
+
+    /// Number of sectors read ahead of sequential reads, and how many of
+    /// them were used before being replaced.
+    unsigned long numSectorsReadAhead;
+    unsigned long numSectorsReadAheadUsed;
+
+    /// Name of the disk scheduling policy.
+    const char *diskSchedulingName;
+
+    /// Number of disk requests served, how many of them had to wait for
+    /// another one, and the ticks they took in all, from being submitted
+    /// to being done.
+    unsigned long numDiskRequests;
+    unsigned long numDiskRequestsQueued;
+    unsigned long diskRequestTicks;
+#endif
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
@@ -66,6 +187,21 @@ public:
 
     /// Print collected statistics.
     void Print();
+
+#ifdef USE_TLB
+private:
+    /// TLB counts of an address space that was destroyed.
+    struct RetiredSpace {
+        unsigned asid;
+        unsigned long tlbHits;
+        unsigned long tlbMisses;
+        RetiredSpace *next;
+    };
+
+    /// Destroyed address spaces, in the order they were destroyed.
+    RetiredSpace *firstRetired;
+    RetiredSpace *lastRetired;
+#endif
 };
 
 /// Constants used to reflect the relative time an operation would take in a
@@ -87,6 +223,10 @@ const unsigned long SEEK_TIME     = 500;
   ///< Time disk takes to seek past one track.
 const unsigned long CONSOLE_TIME  = 100;
   ///< Time to read or write one character.
+const unsigned long SWAP_TIME     = 14000;
+  ///< Time to reach a page of swap and transfer it, about an average
+  ///< access to the disk; further pages in the same transfer cost
+  ///< `ROTATION_TIME` each.
 const unsigned long NETWORK_TIME  = 100;
   ///< Time to send or receive one packet.
 const unsigned long TIMER_TICKS   = 100;
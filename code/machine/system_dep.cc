@@ -34,6 +34,7 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/mman.h>
 #ifdef HOST_i386
@@ -181,6 +182,18 @@ Tell(int fd)
 #endif
 }
 
+/// Identify the file open as `fd`.
+///
+/// Abort on error.
+unsigned long
+FileId(int fd)
+{
+    struct stat info;
+    int retVal = fstat(fd, &info);
+    ASSERT(retVal == 0);
+    return info.st_ino;
+}
+
 /// Close a file.
 ///
 /// Abort on error.
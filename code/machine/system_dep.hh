@@ -41,6 +41,10 @@ namespace SystemDep {
 
     int Tell(int fd);
 
+    /// Return a number that identifies the file open as `fd` while it
+    /// exists (its inode number).
+    unsigned long FileId(int fd);
+
     void Close(int fd);
 
     bool Unlink(const char *name);
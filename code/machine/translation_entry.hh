@@ -54,6 +54,13 @@ public:
     /// This bit is set by the hardware every time the page is modified.
     bool dirty;
 
+    /// Address space the entry belongs to, when it is in the TLB.
+    ///
+    /// The TLB only matches entries whose `asid` equals the one in
+    /// `MMU::asid`, so entries of several address spaces can be resident
+    /// at the same time.  Ignored in page tables.
+    unsigned asid;
+
 };
 
 
@@ -0,0 +1,53 @@
+#!/bin/bash
+# Time `userland/matmult_bench` on one or more Nachos builds, in host wall
+# time.  It multiplies 12x12 matrices 40 times, without paging; use
+# `-p userland/matmult` for the 20x20 one, which pages.
+#
+# Usage: tests/bench_matmult.sh [-n RUNS] [-p PROGRAM] [NACHOS...]
+#
+# Every binary runs the program RUNS times (5 by default) and the best time
+# is reported, together with the simulated ticks of the last run, which must
+# be the same for every build for the comparison to be meaningful.  With no
+# binaries, `vmem/nachos` is used.  To compare against an older tree, build
+# it elsewhere and pass both binaries, for example:
+#
+#     git worktree add /tmp/old <commit> && make -C /tmp/old/code/vmem
+#     tests/bench_matmult.sh /tmp/old/code/vmem/nachos vmem/nachos
+#
+# Must be run from the `code` directory.
+
+runs=5
+program=userland/matmult_bench
+while getopts n:p: opt; do
+    case $opt in
+        n) runs=$OPTARG ;;
+        p) program=$OPTARG ;;
+        *) exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 0 ] && set -- vmem/nachos
+if [ ! -f "$program" ]; then
+    echo "$program not found; build userland with a MIPS cross-compiler" >&2
+    exit 1
+fi
+
+# The console polls standard input and aborts at end of file, so keep it
+# open for the whole benchmark.
+fifo=$(mktemp -u)
+mkfifo "$fifo" || exit 1
+exec 3<>"$fifo"
+rm -f "$fifo"
+
+for nachos in "$@"; do
+    best=
+    for ((i = 0; i < runs; i++)); do
+        start=$(date +%s%N)
+        ticks=$("$nachos" -x "$program" <&3 | grep '^Ticks:')
+        elapsed=$((($(date +%s%N) - start) / 1000000))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    printf '%s: best of %d runs %d ms\n\t%s\n' "$nachos" "$runs" "$best" "$ticks"
+done
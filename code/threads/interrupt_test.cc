@@ -0,0 +1,112 @@
+/// Microbenchmark for the queue of pending interrupts.
+///
+/// Measures how long it takes to fire and reschedule one interrupt, as the
+/// number of interrupts pending grows.  Every step removes the interrupt
+/// that is due first and schedules it again a pseudo-random time later,
+/// which is what the timer, the console and the network devices keep doing
+/// all the time.
+///
+/// The queue used by `Interrupt` (`Heap`) is compared against the sorted
+/// `List` it replaced.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "interrupt_test.hh"
+#include "lib/heap.hh"
+#include "lib/list.hh"
+#include "machine/interrupt.hh"
+
+#include <stdio.h>
+#include <time.h>
+
+
+static const unsigned STEPS = 200000;
+static const unsigned MAX_PENDING = 4096;
+static const unsigned MAX_DELAY = 1000;
+
+static void
+DummyHandler(void *arg)
+{}
+
+/// A small generator of its own, so that running the benchmark does not
+/// change the random numbers seen by the rest of Nachos.
+static unsigned
+NextDelay(unsigned *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return 1 + (*seed >> 16) % MAX_DELAY;
+}
+
+/// Return the nanoseconds per step spent by the sorted list.
+static double
+ListSteps(unsigned numPending)
+{
+    List<PendingInterrupt *> pending;
+    unsigned seed = numPending;
+
+    for (unsigned i = 0; i < numPending; i++) {
+        unsigned when = NextDelay(&seed);
+        pending.SortedInsert(new PendingInterrupt(DummyHandler, nullptr,
+                                                  when, TIMER_INT),
+                             when);
+    }
+
+    clock_t start = clock();
+    for (unsigned i = 0; i < STEPS; i++) {
+        int now;
+        PendingInterrupt *due = pending.SortedPop(&now);
+        delete due;
+        unsigned when = now + NextDelay(&seed);
+        pending.SortedInsert(new PendingInterrupt(DummyHandler, nullptr,
+                                                  when, TIMER_INT),
+                             when);
+    }
+    clock_t end = clock();
+
+    while (!pending.IsEmpty()) {
+        delete pending.Pop();
+    }
+    return (end - start) * 1e9 / CLOCKS_PER_SEC / STEPS;
+}
+
+/// Return the nanoseconds per step spent by the heap.
+static double
+HeapSteps(unsigned numPending)
+{
+    Heap<PendingInterrupt> pending;
+    unsigned seed = numPending;
+
+    for (unsigned i = 0; i < numPending; i++) {
+        unsigned when = NextDelay(&seed);
+        pending.Insert(PendingInterrupt(DummyHandler, nullptr,
+                                        when, TIMER_INT),
+                       when);
+    }
+
+    clock_t start = clock();
+    for (unsigned i = 0; i < STEPS; i++) {
+        unsigned long now;
+        pending.Pop(&now);
+        unsigned long when = now + NextDelay(&seed);
+        pending.Insert(PendingInterrupt(DummyHandler, nullptr,
+                                        when, TIMER_INT),
+                       when);
+    }
+    clock_t end = clock();
+
+    return (end - start) * 1e9 / CLOCKS_PER_SEC / STEPS;
+}
+
+void
+InterruptQueueTest()
+{
+    printf("Pending interrupt queue, %u fire-and-reschedule steps:\n\n",
+           STEPS);
+    printf("%8s %14s %14s\n", "pending", "list (ns)", "heap (ns)");
+    for (unsigned n = 1; n <= MAX_PENDING; n *= 4) {
+        printf("%8u %14.1f %14.1f\n", n, ListSteps(n), HeapSteps(n));
+    }
+}
@@ -11,10 +11,13 @@
 /// =====
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
-///            [-rs <random seed #>] [-z] [-tt]
+///            [-rs <random seed #>] [-z] [-ti] [-tt]
 ///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
-///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
-///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
+///            [-tlb <policy>] [-vm <policy>] [-po] [-fa <pages>]
+///            [-f] [-cp <unix file> <nachos file>]
+///            [-cs <unix file> <nachos file>] [-pr <nachos file>]
+///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf] [-ra <sectors>]
+///            [-ds <policy>] [-tb] [-fr] [-df]
 ///            [-n <network reliability>] [-id <machine id>]
 ///            [-tn <other machine id>]
 ///
@@ -28,6 +31,8 @@
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
 /// * `-z`  -- prints version and copyright information, and exits.
+/// * `-ti` -- measures the performance of the pending interrupt queue, and
+///            exits.
 ///
 /// *THREADS* options
 /// -----------------
@@ -41,18 +46,41 @@
 /// * `-s`  -- causes user programs to be executed in single-step mode.
 /// * `-x`  -- runs a user program.
 /// * `-tc` -- tests the console.
+/// * `-tlb` -- selects the TLB replacement policy: `rr` (round-robin, the
+///             default), `random`, `clock` or `lru`.
+/// * `-vm` -- selects the page replacement policy: `random` (the default),
+///            `fifo`, `lru`, `clock` or `eclock` (enhanced clock, which
+///            prefers clean pages).
+/// * `-po` -- runs the pageout daemon, which writes dirty pages back to
+///            swap ahead of the page faults that evict them.  With
+///            *FILESYS_STUB*, as in the `vmem` build, swap writes are
+///            synchronous, so the daemon cannot overlap them with user
+///            code; it only moves them out of the faults.
+/// * `-fa` -- brings in up to the given number of pages following one that
+///            faults, when faults look sequential.
 ///
 /// *FILESYS* options
 /// -----------------
 ///
 /// * `-f`  -- causes the physical disk to be formatted.
 /// * `-cp` -- copies a file from UNIX to Nachos.
+/// * `-cs` -- copies a file from UNIX to Nachos, a few whole sectors at a
+///            time.
 /// * `-pr` -- prints a Nachos file to standard output.
 /// * `-rm` -- removes a Nachos file from the file system.
 /// * `-ls` -- lists the contents of the Nachos directory.
 /// * `-D`  -- prints the contents of the entire file system.
 /// * `-c`  -- checks the filesystem integrity.
 /// * `-tf` -- tests the performance of the Nachos file system.
+/// * `-ra` -- reads up to the given number of sectors ahead of sequential
+///            reads (16 by default; 0 disables read-ahead).
+/// * `-ds` -- selects the disk scheduling policy: `fifo` (the default),
+///            `sstf` (shortest seek first), `scan` (elevator) or `clook`
+///            (circular elevator).
+/// * `-tb` -- measures the latency of random reads from several threads
+///            under every disk scheduling policy.
+/// * `-fr` -- prints how fragmented the files and the free space are.
+/// * `-df` -- defragments the files.
 ///
 /// *NETWORK* options
 /// -----------------
@@ -74,6 +102,7 @@
 
 
 #include "copyright.h"
+#include "interrupt_test.hh"
 #include "sys_info.hh"
 #include "system.hh"
 #include "thread_test.hh"
@@ -89,8 +118,10 @@
 // External functions used by this file.
 
 void Copy(const char *unixFile, const char *nachosFile);
+void CopySectors(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
+void DiskSchedulingTest(void);
 void StartProcess(const char *file);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
@@ -132,6 +163,10 @@ main(int argc, char **argv)
             PrintVersion();
             return 0;
         }
+        if (!strcmp(*argv, "-ti")) {         // Benchmark the interrupt queue.
+            InterruptQueueTest();
+            return 0;
+        }
 #ifdef THREADS
         if (!strcmp(*argv, "-tt")) {         // Test the threading subsystem.
             ThreadTest();
@@ -161,6 +196,10 @@ main(int argc, char **argv)
             ASSERT(argc > 2);
             Copy(*(argv + 1), *(argv + 2));
             argCount = 3;
+        } else if (!strcmp(*argv, "-cs")) {  // Copy in whole sectors.
+            ASSERT(argc > 2);
+            CopySectors(*(argv + 1), *(argv + 2));
+            argCount = 3;
         } else if (!strcmp(*argv, "-pr")) {  // Print a Nachos file.
             ASSERT(argc > 1);
             Print(*(argv + 1));
@@ -181,6 +220,12 @@ main(int argc, char **argv)
             printf("Filesystem check %s.\n", result ? "succeeded" : "failed");
         } else if (!strcmp(*argv, "-tf")) {  // Performance test.
             PerformanceTest();
+        } else if (!strcmp(*argv, "-tb")) {  // Disk scheduling benchmark.
+            DiskSchedulingTest();
+        } else if (!strcmp(*argv, "-fr")) {  // Fragmentation report.
+            fileSystem->PrintFragmentation();
+        } else if (!strcmp(*argv, "-df")) {  // Defragment the disk.
+            fileSystem->Defragment();
         }
 #endif
 #ifdef NETWORK
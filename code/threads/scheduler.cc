@@ -176,3 +176,9 @@ Scheduler::SwitchPriority(Thread *thread, unsigned newPriority)
     thread->UpdatePriority(newPriority);
     ReadyToRun(thread);
 }
+
+void
+Scheduler::Remove(Thread *thread)
+{
+    readyList[thread->GetPriority()]->Remove(thread);
+}
@@ -42,6 +42,9 @@ public:
 
     void SwitchPriority(Thread* thread, unsigned newPriority);
 
+    /// Take `thread` off the ready list, if it is on it.
+    void Remove(Thread *thread);
+
 private:
 
     // Queue of threads that are ready to run, but not running.
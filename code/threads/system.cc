@@ -14,6 +14,9 @@
 #include "userprog/exception.hh"
 #endif
 
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -40,13 +43,21 @@ FileSystem *fileSystem;
 
 #ifdef FILESYS
 SynchDisk *synchDisk;
+SectorCache *sectorCache;  ///< Caches the sectors of `synchDisk`.
 #endif
 
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
 Machine *machine;  ///< User program memory and registers.
 SynchConsole *synchConsole;
+BufferPool *ioBuffers;  ///< Buffers for file and console transfers.
+#ifdef USE_TLB
+TlbPolicy *tlbPolicy;  ///< Chooses the TLB entries to replace.
+#endif
 #ifdef SWAP
 Coremap *coreMap;
+SwapArea *swapArea;  ///< Holds the evicted pages of every process.
+PageoutDaemon *pageoutDaemon;  ///< Frees frames ahead of faults, if
+                               ///< enabled.
 #else
 Bitmap *usedPages;
 #endif
@@ -115,6 +126,30 @@ ParseDebugOpts(char *s, DebugOpts *out)
     return true;
 }
 
+#if defined(SWAP) || defined(FILESYS)
+/// Parse a count of pages or sectors given on the command line.  Return
+/// false unless `s` is a whole non-negative decimal number that fits in an
+/// `unsigned`.
+static bool
+ParseCount(const char *s, unsigned *out)
+{
+    ASSERT(s != nullptr);
+    ASSERT(out != nullptr);
+
+    if (*s < '0' || *s > '9') {
+        return false;  // Also rejects a sign.
+    }
+    char *end;
+    errno = 0;
+    unsigned long value = strtoul(s, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > UINT_MAX) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+#endif
+
 /// Initialize Nachos global data structures.
 ///
 /// Interpret command line arguments in order to determine flags for the
@@ -144,9 +179,19 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
 #endif
+#ifdef USE_TLB
+    const char *tlbPolicyName = "rr";  // TLB replacement policy.
+#endif
+#ifdef SWAP
+    ReplacementPolicy pagePolicy = REPLACE_RANDOM;  // Page replacement.
+    bool pageout = false;  // Run the pageout daemon.
+#endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
 #endif
+#ifdef FILESYS
+    DiskSchedulingPolicy diskPolicy = DISK_FIFO;
+#endif
 #ifdef NETWORK
     double rely = 1;  // Network reliability.
     int netname = 0;  // UNIX socket name.
@@ -188,11 +233,58 @@ Initialize(int argc, char **argv)
             debugUserProg = true;
         }
 #endif
+#ifdef USE_TLB
+        if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 1);
+            tlbPolicyName = *(argv + 1);
+            argCount = 2;
+        }
+#endif
+#ifdef SWAP
+        if (!strcmp(*argv, "-vm")) {
+            ASSERT(argc > 1);
+            if (!Coremap::ParsePolicy(*(argv + 1), &pagePolicy)) {
+                fprintf(stderr, "Unknown page replacement policy `%s`.\n",
+                        *(argv + 1));
+                exit(1);
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-po")) {
+            pageout = true;
+        } else if (!strcmp(*argv, "-fa")) {
+            ASSERT(argc > 1);
+            if (!ParseCount(*(argv + 1), &AddressSpace::faultAroundWindow)) {
+                fprintf(stderr, "Invalid fault-around window `%s`.\n",
+                        *(argv + 1));
+                exit(1);
+            }
+            argCount = 2;
+        }
+#endif
 #ifdef FILESYS_NEEDED
         if (!strcmp(*argv, "-f")) {
             format = true;
         }
 #endif
+#ifdef FILESYS
+        if (!strcmp(*argv, "-ra")) {
+            ASSERT(argc > 1);
+            if (!ParseCount(*(argv + 1), &OpenFile::readAheadLimit)) {
+                fprintf(stderr, "Invalid read-ahead limit `%s`.\n",
+                        *(argv + 1));
+                exit(1);
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ds")) {
+            ASSERT(argc > 1);
+            if (!SynchDisk::ParsePolicy(*(argv + 1), &diskPolicy)) {
+                fprintf(stderr, "Unknown disk scheduling policy `%s`.\n",
+                        *(argv + 1));
+                exit(1);
+            }
+            argCount = 2;
+        }
+#endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-n")) {
             ASSERT(argc > 1);
@@ -238,8 +330,19 @@ Initialize(int argc, char **argv)
     Debugger *d = debugUserProg ? new Debugger : nullptr;
     machine = new Machine(d);  // This must come first.
     synchConsole = new SynchConsole("Synch Console");
+    ioBuffers = new BufferPool(NUM_IO_BUFFERS, IO_BUFFER_SIZE);
+#ifdef USE_TLB
+    tlbPolicy = TlbPolicy::Create(tlbPolicyName);
+    if (tlbPolicy == nullptr) {
+        fprintf(stderr, "Unknown TLB replacement policy `%s`.\n",
+                tlbPolicyName);
+        exit(1);
+    }
+    stats->tlbPolicyName = tlbPolicy->GetName();
+#endif
     #ifdef SWAP
-        coreMap = new Coremap(NUM_PHYS_PAGES);
+        coreMap = new Coremap(NUM_PHYS_PAGES, pagePolicy);
+        stats->pageReplacementName = Coremap::GetPolicyName(pagePolicy);
     #else
         usedPages = new Bitmap(NUM_PHYS_PAGES);
     #endif
@@ -249,13 +352,19 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", diskPolicy);
+    sectorCache = new SectorCache(synchDisk);
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef SWAP
+    swapArea = new SwapArea("SWAP", NUM_SWAP_SLOTS);
+    pageoutDaemon = pageout ? new PageoutDaemon : nullptr;
+#endif
+
 #ifdef FILESYS
     fileSystem->firstThreadStart();
 #endif
@@ -281,6 +390,10 @@ Cleanup()
 #ifdef USER_PROGRAM
     delete machine;
     delete synchConsole;
+    delete ioBuffers;
+#ifdef USE_TLB
+    delete tlbPolicy;
+#endif
     #ifdef SWAP
         delete coreMap;
     #else
@@ -289,11 +402,17 @@ Cleanup()
     delete runningThreads;
 #endif
 
+#ifdef SWAP
+    delete pageoutDaemon;
+    delete swapArea;
+#endif
+
 #ifdef FILESYS_NEEDED
     delete fileSystem;
 #endif
 
 #ifdef FILESYS
+    delete sectorCache;
     delete synchDisk;
 #endif
 
@@ -36,13 +36,24 @@ extern Timer *timer;                 ///< The hardware alarm clock.
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
 #include "userprog/synch_console.hh"
+#include "userprog/buffer_pool.hh"
 extern Machine *machine;  // User program memory and registers.
 extern SynchConsole *synchConsole;
+extern BufferPool *ioBuffers;  // Buffers for `Read` and `Write`.
 extern Table<Thread*> *runningThreads;
 
+#ifdef USE_TLB
+#include "userprog/tlb_policy.hh"
+extern TlbPolicy *tlbPolicy;
+#endif
+
 #ifdef SWAP
 #include "lib/coremap.hh"
 extern Coremap* coreMap;
+#include "userprog/swap_area.hh"
+extern SwapArea *swapArea;
+#include "userprog/pageout_daemon.hh"
+extern PageoutDaemon *pageoutDaemon;
 #else
 #include "lib/bitmap.hh"
 extern Bitmap* usedPages;
@@ -56,7 +67,9 @@ extern FileSystem *fileSystem;
 
 #ifdef FILESYS
 #include "filesys/synch_disk.hh"
+#include "filesys/sector_cache.hh"
 extern SynchDisk *synchDisk;
+extern SectorCache *sectorCache;
 #endif
 
 #ifdef NETWORK
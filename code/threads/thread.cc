@@ -41,7 +41,10 @@ IsThreadStatus(ThreadStatus s)
 /// `Thread::Fork`.
 ///
 /// * `threadName` is an arbitrary string, useful for debugging.
-Thread::Thread(const char *threadName, bool joinable, unsigned int prio)
+/// * `daemon` tells whether the thread is a kernel daemon, which does not
+///   count as a process.
+Thread::Thread(const char *threadName, bool joinable, unsigned int prio,
+               bool daemon)
 {
     name     = threadName;
     stackTop = nullptr;
@@ -58,7 +61,7 @@ Thread::Thread(const char *threadName, bool joinable, unsigned int prio)
     filesTable->Add(nullptr); // Console INPUT
     filesTable->Add(nullptr); // Console OUTPUT
 
-    spaceId = runningThreads->Add(this);
+    spaceId = daemon ? -1 : runningThreads->Add(this);
 #endif
 #ifdef FILESYS
     currentDirLock = nullptr;
@@ -197,6 +200,9 @@ Thread::Finish(int returnValue)
 #ifdef USER_PROGRAM
     if (runningThreads->Count() == 1)
     {
+        if (space != nullptr) {
+            space->SaveState();  // Account for its statistics.
+        }
         interrupt->Halt();
     }
 #endif
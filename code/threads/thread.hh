@@ -104,7 +104,12 @@ private:
 public:
 
     /// Initialize a `Thread`.
-    Thread(const char *debugName, bool joinable, unsigned int prio);
+    ///
+    /// A `daemon` thread does housekeeping for the kernel.  It is not a
+    /// process: it gets no process identifier, and does not keep Nachos
+    /// from halting once every process has finished.
+    Thread(const char *debugName, bool joinable, unsigned int prio,
+           bool daemon = false);
 
     /// Deallocate a Thread.
     ///
@@ -170,6 +175,7 @@ private:
 
     // Thread joinable, if not channel never allocated
     bool join;
+
     Channel *channel = nullptr;
     
     unsigned int priority;
@@ -0,0 +1,69 @@
+/// Test program for `Fork`.
+///
+/// Parent and child both write to the same array after forking, and each
+/// checks that it only sees its own writes: the copy-on-write sharing set
+/// up by `Fork` must give each of them a private copy of the pages they
+/// write to.  The array spans many pages, so that some of them are only
+/// read, some written by one process and some by both.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define DIM  1024
+
+static int A[DIM];
+
+/// Write `i * factor + offset` into the elements `i` of `A` with
+/// `from <= i < to`.
+static void
+Fill(int from, int to, int factor, int offset)
+{
+    for (int i = from; i < to; i++) {
+        A[i] = i * factor + offset;
+    }
+}
+
+/// Return the number of elements of `A` with `from <= i < to` that do not
+/// hold `i * factor + offset`.
+static int
+Check(int from, int to, int factor, int offset)
+{
+    int wrong = 0;
+    for (int i = from; i < to; i++) {
+        if (A[i] != i * factor + offset) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+int
+main(void)
+{
+    Fill(0, DIM, 1, 0);
+
+    SpaceId child = Fork(1);
+    if (child == 0) {
+        // The child rewrites the first half.  By the time it runs, the
+        // parent has already written to its own copy.
+        Fill(0, DIM / 2, 3, 1);
+        int wrong = Check(0, DIM / 2, 3, 1) + Check(DIM / 2, DIM, 1, 0);
+        putS(wrong == 0 ? "Child sees its own data.\n"
+                        : "Child sees data it did not write.\n");
+        Exit(wrong);
+    }
+
+    // The parent rewrites the second quarter, which the child also wrote,
+    // and the last quarter, which the child only read.
+    Fill(DIM / 4, DIM / 2, 5, 2);
+    Fill(3 * DIM / 4, DIM, 5, 2);
+    int childWrong = Join(child);
+    int wrong = Check(0, DIM / 4, 1, 0) + Check(DIM / 4, DIM / 2, 5, 2)
+              + Check(DIM / 2, 3 * DIM / 4, 1, 0)
+              + Check(3 * DIM / 4, DIM, 5, 2);
+    putS(wrong == 0 ? "Parent sees its own data.\n"
+                    : "Parent sees data it did not write.\n");
+    return wrong != 0 || childWrong != 0;
+}
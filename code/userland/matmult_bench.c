@@ -0,0 +1,45 @@
+/// Benchmark for the instruction interpreter: matrix multiplication on
+/// arrays small enough to stay in physical memory, repeated a few times.
+///
+/// Used by `tests/bench_matmult.sh`.  Unlike `matmult`, it never pages, so
+/// the time goes to running user code rather than to the disk.
+
+
+#include "syscall.h"
+
+
+#define DIM      12
+#define REPEATS  40
+
+static int A[DIM][DIM];
+static int B[DIM][DIM];
+static int C[DIM][DIM];
+
+int
+main(void)
+{
+    int i, j, k, r;
+
+    for (r = 0; r < REPEATS; r++) {
+        // First initialize the matrices.
+        for (i = 0; i < DIM; i++) {
+            for (j = 0; j < DIM; j++) {
+                A[i][j] = i;
+                B[i][j] = j;
+                C[i][j] = 0;
+            }
+        }
+
+        // Then multiply them together.
+        for (i = 0; i < DIM; i++) {
+            for (j = 0; j < DIM; j++) {
+                for (k = 0; k < DIM; k++) {
+                    C[i][j] += A[i][k] * B[k][j];
+                }
+            }
+        }
+    }
+
+    // And then we are done.
+    return C[DIM - 1][DIM - 1];
+}
@@ -125,6 +125,38 @@ Write:
         j       $31
         .end    Write
 
+        .globl  ReadV
+        .ent    ReadV
+ReadV:
+        addiu   $2, $0, SC_READV
+        syscall
+        j       $31
+        .end    ReadV
+
+        .globl  WriteV
+        .ent    WriteV
+WriteV:
+        addiu   $2, $0, SC_WRITEV
+        syscall
+        j       $31
+        .end    WriteV
+
+        .globl  PRead
+        .ent    PRead
+PRead:
+        addiu   $2, $0, SC_PREAD
+        syscall
+        j       $31
+        .end    PRead
+
+        .globl  PWrite
+        .ent    PWrite
+PWrite:
+        addiu   $2, $0, SC_PWRITE
+        syscall
+        j       $31
+        .end    PWrite
+
         .globl  Close
         .ent    Close
 Close:
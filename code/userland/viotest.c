@@ -0,0 +1,102 @@
+/// Test program for `ReadV`, `WriteV`, `PRead` and `PWrite`.
+///
+/// Writes a file from several segments in one call, reads it back into
+/// segments that are longer than the file, patches and reads it at given
+/// positions, and checks that the console refuses positioned transfers.
+/// Each check that fails is reported; the exit status is the number of
+/// them.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define SIZE  1000
+
+static char data[SIZE];
+static char back[1200];
+static char extra[10];
+
+static int failures;
+
+static void
+Expect(int ok, const char *what)
+{
+    if (!ok) {
+        putS("Failed: ");
+        putS(what);
+        putS("\n");
+        failures++;
+    }
+}
+
+/// Return whether the `size` bytes at `a` and `b` are equal.
+static int
+Same(const char *a, const char *b, int size)
+{
+    for (int i = 0; i < size; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int
+main(void)
+{
+    for (int i = 0; i < SIZE; i++) {
+        data[i] = i * 7;
+    }
+    for (int i = 0; i < 10; i++) {
+        extra[i] = 'x';
+    }
+
+    Create("viotest.bin");
+    OpenFileId fid = Open("viotest.bin");
+    if (fid < 2) {
+        putS("Error: could not open the file.\n");
+        return 1;
+    }
+
+    struct IoVec out[3] = {
+        { data, 100 }, { data + 100, 50 }, { data + 150, SIZE - 150 }
+    };
+    Expect(WriteV(out, 3, fid) == SIZE, "WriteV of three segments");
+    Close(fid);
+
+    // The file ends inside the second segment: it is only partly filled,
+    // and the third is not touched.
+    fid = Open("viotest.bin");
+    struct IoVec in[3] = {
+        { back, 300 }, { back + 300, 900 }, { extra, 10 }
+    };
+    Expect(ReadV(in, 3, fid) == SIZE, "ReadV stops at the end of file");
+    Expect(Same(back, data, SIZE), "ReadV fills segments in order");
+    Expect(extra[0] == 'x', "ReadV leaves segments past a short read");
+
+    // Positioned transfers do not move the file position, which is left
+    // at the end of the file by `ReadV`.
+    Expect(PWrite("patch", 5, 10, fid) == 5, "PWrite");
+    data[10] = 'p'; data[11] = 'a'; data[12] = 't';
+    data[13] = 'c'; data[14] = 'h';
+    Expect(PRead(back, 100, 0, fid) == 100, "PRead");
+    Expect(Same(back, data, 100), "PRead sees what PWrite wrote");
+    Expect(PRead(back, 100, SIZE - 40, fid) == 40,
+           "PRead stops at the end of file");
+    Expect(Read(back, 1, fid) == 0, "positioned transfers keep the position");
+    Close(fid);
+    Remove("viotest.bin");
+
+    Expect(PRead(back, 5, 0, CONSOLE_INPUT) == -1,
+           "the console rejects PRead");
+    Expect(PWrite("x", 1, 0, CONSOLE_OUTPUT) == -1,
+           "the console rejects PWrite");
+
+    struct IoVec message[2] = {
+        { "Vectored I/O test ", 18 },
+        { failures == 0 ? "passed.\n" : "FAILED.\n", 8 }
+    };
+    WriteV(message, 2, CONSOLE_OUTPUT);
+    return failures;
+}
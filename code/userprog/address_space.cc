@@ -9,13 +9,18 @@
 #include "address_space.hh"
 #include "threads/system.hh"
 
+#include <string.h>
+
+
+Bitmap AddressSpace::usedAsids (Statistics::MAX_SPACES);
+
 #ifdef SWAP
-#include "filesys/directory_entry.hh"
+unsigned AddressSpace::faultAroundWindow = 0;
 #endif
 
-#include <string.h>
-#include <stdio.h>
-
+#ifdef USE_TLB
+AddressSpace *AddressSpace::tlbOwners[TLB_SIZE];
+#endif
 
 /// First, set up the translation from program memory to physical memory.
 /// For now, this is really simple (1:1), since we are only uniprogramming,
@@ -24,10 +29,16 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
 {
     ASSERT(executable_file != nullptr);
 
+    // Taken before anything can block, so that the identifier checked by
+    // `CanCreate` is still free.
+    asid = AllocateAsid();
+    outOfMemory = false;
+
     Executable exe (executable_file);
     ASSERT(exe.CheckMagic());
 #ifdef DEMAND_LOADING
     executable = executable_file;
+    executableUsers = new unsigned(1);
     codeSize = exe.GetCodeSize();
     initDataSize = exe.GetInitDataSize();
     codeAddr = exe.GetCodeAddr();
@@ -40,15 +51,19 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
     // We need to increase the size to leave room for the stack.
     numPages = DivRoundUp(size, PAGE_SIZE);
     size = numPages * PAGE_SIZE;
-    tlbIndex = 0;
+#ifdef USE_TLB
+    hitsOnRestore = 0;
+#endif
 
 #ifdef SWAP
-    swapName = new char[FILE_NAME_MAX_LEN];
-    snprintf(swapName, FILE_NAME_MAX_LEN, "SWAP.%u", pid);
-    ASSERT(fileSystem->Create(swapName, size));
-    ASSERT(swapFile = fileSystem->Open(swapName));
-    DEBUG('p', "Archivo swap creado nombre %s\n", swapName);
-    inSwap = new Bitmap(numPages);
+    swapSlots = new int[numPages];
+    for (unsigned i = 0; i < numPages; i++) {
+        swapSlots[i] = -1;
+    }
+    expectedFault = 0;
+    faultAroundPages = 0;
+    executableId = executable_file->GetFileId();
+    copyOnWrite = new bool[numPages]();
 #else
     // Check we are not trying to run anything too big -- at least until we
     // have virtual memory.
@@ -84,6 +99,7 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
         // If the code segment was entirely on a separate page, we could
         // set its pages to be read-only.
 #ifndef DEMAND_LOADING
+        machine->GetMMU()->InvalidateFrame(pageTable[i].physicalPage);
         memset(mainMemory + (pageTable[i].physicalPage * PAGE_SIZE), 0, PAGE_SIZE);
 #endif
     }
@@ -123,32 +139,142 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
 #endif
 }
 
+/// The page table is cloned.  Pages in memory are mapped to the same frames
+/// in both spaces, and those that can be written to are made read-only in
+/// both, to be copied by `CopyOnWrite` on the first write.  Pages in swap
+/// share their slots until either space writes them back.  The work done
+/// only depends on the number of pages, not on how many are in memory.
+AddressSpace::AddressSpace(AddressSpace *parent)
+{
+    ASSERT(parent != nullptr);
+
+    numPages = parent->numPages;
+    asid = AllocateAsid();
+    outOfMemory = false;
+#ifdef USE_TLB
+    hitsOnRestore = 0;
+
+    // Bring the `dirty` bits of the parent into its page table, and drop
+    // the translations that let it write to the pages to be shared.
+    parent->InvalidateTLB();
+#endif
+#ifdef DEMAND_LOADING
+    executable = parent->executable;
+    executableUsers = parent->executableUsers;
+    (*executableUsers)++;
+    codeSize = parent->codeSize;
+    initDataSize = parent->initDataSize;
+    codeAddr = parent->codeAddr;
+    initDataAddr = parent->initDataAddr;
+#endif
+
+    DEBUG('a', "Duplicating address space, num pages %u\n", numPages);
+
+    pageTable = new TranslationEntry[numPages];
+#ifdef SWAP
+    swapSlots = new int[numPages];
+    copyOnWrite = new bool[numPages]();
+    expectedFault = 0;
+    faultAroundPages = 0;
+    executableId = parent->executableId;
+    for (unsigned i = 0; i < numPages; i++) {
+        pageTable[i] = parent->pageTable[i];
+        swapSlots[i] = parent->swapSlots[i];
+        if (swapSlots[i] != -1) {
+            swapArea->Share(swapSlots[i]);
+        }
+        if (!pageTable[i].valid) {
+            continue;
+        }
+        if (coreMap->IsZeroFrame(pageTable[i].physicalPage)) {
+            coreMap->MapZeroFrame();
+        } else {
+            coreMap->Share(pageTable[i].physicalPage, i, this);
+        }
+        if (!pageTable[i].readOnly || parent->copyOnWrite[i]) {
+            parent->pageTable[i].readOnly = true;
+            parent->copyOnWrite[i] = true;
+            pageTable[i].readOnly = true;
+            copyOnWrite[i] = true;
+        }
+    }
+#else
+    ASSERT(numPages <= usedPages->CountClear());
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    for (unsigned i = 0; i < numPages; i++) {
+        pageTable[i] = parent->pageTable[i];
+        if (!pageTable[i].valid) {
+            continue;
+        }
+        unsigned frame = usedPages->Find();
+        machine->GetMMU()->InvalidateFrame(frame);
+        memcpy(mainMemory + frame * PAGE_SIZE,
+               mainMemory + parent->pageTable[i].physicalPage * PAGE_SIZE,
+               PAGE_SIZE);
+        pageTable[i].physicalPage = frame;
+    }
+#endif
+}
+
 /// Deallocate an address space.
 ///
 /// Nothing for now!
 AddressSpace::~AddressSpace()
 {
+#ifdef USE_TLB
+    InvalidateTLB();
+#endif
     for(unsigned i = 0 ; i < numPages ; i++) 
     {
         if(pageTable[i].valid) 
         {
             #ifdef SWAP
-                coreMap->Clear(pageTable[i].physicalPage);
+                if (coreMap->IsZeroFrame(pageTable[i].physicalPage)) {
+                    coreMap->UnmapZeroFrame();
+                } else {
+                    coreMap->Release(pageTable[i].physicalPage, i, this);
+                }
             #else
                 usedPages->Clear(pageTable[i].physicalPage);
             #endif
         }
     }
 #ifdef DEMAND_LOADING
-    delete executable;
+    if (--*executableUsers == 0) {
+        delete executable;
+        delete executableUsers;
+    }
 #endif
 #ifdef SWAP
-    delete swapFile;
-    fileSystem->Remove(swapName);
-    delete inSwap;
+    for (unsigned i = 0; i < numPages; i++) {
+        if (swapSlots[i] != -1) {
+            swapArea->Free(swapSlots[i]);
+        }
+    }
+    delete [] swapSlots;
+    delete [] copyOnWrite;
 #endif
     delete [] pageTable;
 
+#ifdef USE_TLB
+    stats->RetireSpace(asid);
+#endif
+    // No TLB entry carries the identifier any more.
+    usedAsids.Clear(asid);
+}
+
+bool
+AddressSpace::CanCreate()
+{
+    return usedAsids.CountClear() > 0;
+}
+
+unsigned
+AddressSpace::AllocateAsid()
+{
+    int id = usedAsids.Find();
+    ASSERT(id != -1);  // Checked by `CanCreate`.
+    return id;
 }
 
 /// Set the initial values for the user-level register set.
@@ -182,40 +308,41 @@ AddressSpace::InitRegisters()
 /// On a context switch, save any machine state, specific to this address
 /// space, that needs saving.
 ///
-/// For now, nothing!
+/// TLB entries are tagged with the address space identifier, so they can
+/// stay in the TLB; only the hits of this space are accounted for.
 void
 AddressSpace::SaveState()
 {
-    //DEBUG('p', "Saving TLB pages on context switch\n");
-    for(unsigned page = 0; page < TLB_SIZE; page++)
-    {
-        SavePageFromTLB(page);
-    }
+#ifdef USE_TLB
+    stats->spaceTlbHits[asid] += stats->numPageHits - hitsOnRestore;
+#endif
 }
 
 /// On a context switch, restore the machine state so that this address space
 /// can run.
 ///
-/// For now, tell the machine where to find the page table.
+/// With a TLB, tell the MMU which entries belong to this space; otherwise,
+/// tell the machine where to find the page table.
 void
 AddressSpace::RestoreState()
 {
 #ifdef USE_TLB
-    InvalidateTLB();
-    //DEBUG('p', "TLB has been invalidated\n");
+    machine->GetMMU()->asid = asid;
+    hitsOnRestore = stats->numPageHits;
 #else
     machine->GetMMU()->pageTable     = pageTable;
     machine->GetMMU()->pageTableSize = numPages;
 #endif
 }
 
+#ifdef USE_TLB
 void
 AddressSpace::InvalidateTLB()
 {
-    TranslationEntry *tlb = machine->GetMMU()->tlb;
-    for(unsigned i = 0; i < TLB_SIZE; i++)
-    {
-        tlb[i].valid = false;
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (tlbOwners[i] == this) {
+            SavePageFromTLB(i);
+        }
     }
 }
 
@@ -224,13 +351,44 @@ AddressSpace::SavePageFromTLB(unsigned page)
 {
     DEBUG('p', "Saving tlb page in index %u\n", page);
     TranslationEntry *tlb = machine->GetMMU()->tlb;
+    AddressSpace *owner = tlbOwners[page];
     if (tlb[page].valid)
     {
-        pageTable[tlb[page].virtualPage].dirty = tlb[page].dirty;
-        pageTable[tlb[page].virtualPage].use   = tlb[page].use;
+        ASSERT(owner != nullptr && owner->asid == tlb[page].asid);
+        TranslationEntry *entry = &owner->pageTable[tlb[page].virtualPage];
+        entry->dirty = tlb[page].dirty;
+        if (tlb[page].use) {
+            entry->use = true;
+        }
         tlb[page].valid = false;
     }
+    tlbOwners[page] = nullptr;
+}
+
+/// The page clock of the coremap may not have collected the reference yet,
+/// so it is kept in the page table rather than lost.
+void
+AddressSpace::ClearTlbUse(unsigned page)
+{
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    AddressSpace *owner = tlbOwners[page];
+    if (tlb[page].valid && tlb[page].use) {
+        ASSERT(owner != nullptr && owner->asid == tlb[page].asid);
+        owner->pageTable[tlb[page].virtualPage].use = true;
+    }
+    tlb[page].use = false;
+}
+
+/// Entries are tagged with the identifier of the space, so the hash table
+/// of the MMU finds them without looking at the whole TLB.
+int
+AddressSpace::FindTlbEntry(unsigned vpn) const
+{
+    int i = machine->GetMMU()->FindTlbEntry(vpn, asid);
+    ASSERT(i == -1 || tlbOwners[i] == this);
+    return i;
 }
+#endif
 
 bool 
 AddressSpace::SetTlbPage(TranslationEntry *pageTranslation)
@@ -241,14 +399,20 @@ AddressSpace::SetTlbPage(TranslationEntry *pageTranslation)
         return false;
     }
     TranslationEntry *tlb = machine->GetMMU()->tlb;
+    unsigned tlbIndex = tlbPolicy->PickVictim();
+    ASSERT(tlbIndex < TLB_SIZE);
     DEBUG('p', "Set Tlb in page: %d \n", tlbIndex);
 
     if(tlb[tlbIndex].valid)
     {
         SavePageFromTLB(tlbIndex);
+        stats->numTlbEvictions++;
     }
     tlb[tlbIndex] = *pageTranslation;
-    tlbIndex = (tlbIndex + 1) % TLB_SIZE;
+    tlb[tlbIndex].asid = asid;
+    machine->GetMMU()->LoadedTlbEntry(tlbIndex);
+    tlbOwners[tlbIndex] = this;
+    stats->spaceTlbMisses[asid]++;
     return true;
 #else
     DEBUG('p', "TLB not present in the machine.\n");
@@ -263,14 +427,22 @@ AddressSpace::GetTranslationEntry(unsigned vpn)
     if(!page->valid)
     {
 #ifdef SWAP
-        if(inSwap->Test(vpn))
+        stats->numPageLoads++;
+        FaultAround(vpn);
+        unsigned long start = stats->swapTicks;
+        bool loaded;
+        if(swapSlots[vpn] != -1)
         {
-            ReadFromSwap(vpn);
+            loaded = ReadFromSwap(vpn);
         }
         else
         {
-            LoadPage(vpn);
+            loaded = LoadPage(vpn);
+        }
+        if (!loaded) {
+            return nullptr;
         }
+        stats->RecordFaultServiceTime(stats->swapTicks - start);
 #else
         LoadPage(vpn);
 #endif
@@ -278,21 +450,82 @@ AddressSpace::GetTranslationEntry(unsigned vpn)
     return page;
 }
 
+bool
+AddressSpace::HandlePageFault(unsigned vpn)
+{
+    ASSERT(vpn < numPages);
 
+    TranslationEntry *entry = GetTranslationEntry(vpn);
+    if (entry == nullptr) {
+        outOfMemory = true;
+        return false;
+    }
+    SetTlbPage(entry);
+    stats->numPageFaults++;
+#ifdef SWAP
+    if (pageoutDaemon != nullptr) {
+        pageoutDaemon->Check();
+    }
+#endif
+    return true;
+}
 
-void
+bool
+AddressSpace::IsOutOfMemory() const
+{
+    return outOfMemory;
+}
+
+
+
+bool
 AddressSpace::LoadPage(unsigned vpn)
 {
     DEBUG('p', "Loading page %u\n", vpn);
 
 #ifdef SWAP
+    if (!HasBackingStore(vpn)) {
+        // Nothing but zeros: the page only needs a frame of its own once
+        // it is written to.
+        DEBUG('p', "Mapping page %u to the zero frame\n", vpn);
+        int zeroFrame = coreMap->MapZeroFrame();
+        if (zeroFrame == -1) {
+            return false;
+        }
+        pageTable[vpn].physicalPage = zeroFrame;
+        pageTable[vpn].virtualPage  = vpn;
+        pageTable[vpn].readOnly     = true;
+        pageTable[vpn].valid        = true;
+        copyOnWrite[vpn] = true;
+        stats->numZeroPageMaps++;
+        return true;
+    }
+
+    bool shareable = IsCodePage(vpn);
+    if (shareable) {
+        int shared = coreMap->FindShared(executableId, vpn);
+        if (shared != -1) {
+            DEBUG('p', "Sharing frame %d for code page %u\n", shared, vpn);
+            coreMap->Share(shared, vpn, this);
+            pageTable[vpn].physicalPage = shared;
+            pageTable[vpn].virtualPage  = vpn;
+            pageTable[vpn].readOnly     = true;
+            pageTable[vpn].valid        = true;
+            stats->numSharedCodePages++;
+            return true;
+        }
+    }
     int frame = coreMap->Find(vpn, this);
+    if (frame == -1) {
+        return false;
+    }
 #else
     int frame = usedPages->Find();
     ASSERT(frame != -1);
 #endif
 
     DEBUG('p', "Physical page found\n");
+    machine->GetMMU()->InvalidateFrame(frame);
     unsigned virtualAddr = vpn * PAGE_SIZE;
     pageTable[vpn].physicalPage = frame;
     pageTable[vpn].virtualPage  = vpn;
@@ -343,14 +576,81 @@ AddressSpace::LoadPage(unsigned vpn)
         bytesRead += size;
         pageTable[vpn].readOnly = false;
     }
+#ifdef SWAP
+    if (shareable) {
+        coreMap->Publish(frame, executableId, vpn);
+    }
+#endif
+    return true;
 }
 
+/// The contents of a shared page are set aside before the page is unmapped,
+/// since finding a frame for the copy may evict the shared frame itself.
+bool
+AddressSpace::CopyOnWrite(unsigned vpn)
+{
 #ifdef SWAP
-void
+    if (vpn >= numPages || !copyOnWrite[vpn]) {
+        return false;
+    }
+
+    TranslationEntry *entry = &pageTable[vpn];
+    ASSERT(entry->valid);
+    DEBUG('p', "Write to copy-on-write page %u\n", vpn);
+    stats->numCopyOnWriteFaults++;
+#ifdef USE_TLB
+    int i = FindTlbEntry(vpn);
+    if (i != -1) {
+        SavePageFromTLB(i);
+    }
+#endif
+
+    bool zero = coreMap->IsZeroFrame(entry->physicalPage);
+    if (zero || coreMap->IsShared(entry->physicalPage)) {
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        char contents[PAGE_SIZE];
+        memcpy(contents, mainMemory + entry->physicalPage * PAGE_SIZE,
+               PAGE_SIZE);
+        if (zero) {
+            coreMap->UnmapZeroFrame();
+        } else {
+            coreMap->Release(entry->physicalPage, vpn, this);
+        }
+        entry->valid = false;
+
+        int frame = coreMap->Find(vpn, this);
+        if (frame == -1) {
+            // The page is left out of memory, and the process is to exit.
+            outOfMemory = true;
+            return false;
+        }
+        machine->GetMMU()->InvalidateFrame(frame);
+        memcpy(mainMemory + frame * PAGE_SIZE, contents, PAGE_SIZE);
+        entry->physicalPage = frame;
+        entry->valid = true;
+        // The swap slot or the executable do not hold what the page holds
+        // now.
+        entry->dirty = true;
+        stats->numCopyOnWriteCopies++;
+    }
+    entry->readOnly = false;
+    copyOnWrite[vpn] = false;
+    SetTlbPage(entry);
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef SWAP
+bool
 AddressSpace::ReadFromSwap(unsigned vpn) 
 {
     char *mainMemory = machine->GetMMU()->mainMemory;
-    unsigned physicalPage = coreMap->Find(vpn, this);
+    int physicalPage = coreMap->Find(vpn, this);
+    if (physicalPage == -1) {
+        return false;
+    }
     DEBUG('p', "Cargando vpn %lu en la ppn %lu desde la swap\n", vpn, physicalPage);
 
     pageTable[vpn].valid = true;
@@ -359,8 +659,11 @@ AddressSpace::ReadFromSwap(unsigned vpn)
     pageTable[vpn].physicalPage = physicalPage;
 
     unsigned physicalAddr = physicalPage * PAGE_SIZE;
-    swapFile->ReadAt(mainMemory + physicalAddr, PAGE_SIZE, vpn * PAGE_SIZE);
-    inSwap->Clear(vpn);
+    machine->GetMMU()->InvalidateFrame(physicalPage);
+    swapArea->ReadSlot(swapSlots[vpn], mainMemory + physicalAddr);
+    // The copy in swap stays valid until the page is written to, so the
+    // page can be evicted again without writing it back while it is clean.
+    return true;
 }
 
 void
@@ -368,26 +671,188 @@ AddressSpace::WriteToSwap(unsigned vpn)
 {
     char *mainMemory = machine->GetMMU()->mainMemory;
     unsigned physicalAddr = pageTable[vpn].physicalPage * PAGE_SIZE;
+#ifdef USE_TLB
+    // The page may still be in the TLB, even if this space is not running,
+    // and the TLB has the up to date dirty bit.
+    int i = FindTlbEntry(vpn);
+    if (i != -1) {
+        SavePageFromTLB(i);
+    }
+#endif
     pageTable[vpn].valid = false;
+    if (copyOnWrite[vpn]) {
+        // Whatever brings the page back gives it a frame of its own.
+        copyOnWrite[vpn] = false;
+        pageTable[vpn].readOnly = false;
+    }
 
     if (pageTable[vpn].dirty) 
     {
         DEBUG('p', "Desalojando physical page number %lu con vpn %lu DIRTY\n", pageTable[vpn].physicalPage, vpn);
-        ASSERT(swapFile->WriteAt(mainMemory + physicalAddr, PAGE_SIZE, vpn * PAGE_SIZE) == PAGE_SIZE);
-        inSwap->Mark(vpn);
+        if (swapSlots[vpn] != -1 && swapArea->IsShared(swapSlots[vpn])) {
+            // Other spaces forked from this one still need the old copy.
+            swapArea->Free(swapSlots[vpn]);
+            swapSlots[vpn] = -1;
+        }
+        if (swapSlots[vpn] == -1) {
+            swapSlots[vpn] = swapArea->Allocate(NeighbourSlot(vpn));
+            ASSERT(swapSlots[vpn] != -1);  // Checked by `Coremap::Evict`.
+        }
+        swapArea->WriteSlot(swapSlots[vpn], mainMemory + physicalAddr);
     } else {
         DEBUG('p', "Desalojando physical page number %lu con vpn %lu CLEAN\n", pageTable[vpn].physicalPage, vpn);
     }
+}
+#endif
 
-    TranslationEntry *tlb = machine->GetMMU()->tlb;
-    for (unsigned int i = 0; i < TLB_SIZE; i++)
-    {
-        if (tlb[i].valid && tlb[i].virtualPage == vpn)
-        {
-            tlb[i].valid = false;
+#ifdef SWAP
+/// Return the slot right after the one of the previous page, or right
+/// before the one of the next page, so that pages close in the address
+/// space stay close in swap.
+int
+AddressSpace::NeighbourSlot(unsigned vpn) const
+{
+    if (vpn > 0 && swapSlots[vpn - 1] != -1) {
+        return swapSlots[vpn - 1] + 1;
+    }
+    if (vpn + 1 < numPages && swapSlots[vpn + 1] > 0) {
+        return swapSlots[vpn + 1] - 1;
+    }
+    return -1;
+}
+
+/// Only pages holding nothing but code qualify: the page with the end of
+/// the code and the start of the data is written to.
+bool
+AddressSpace::IsCodePage(unsigned vpn) const
+{
+    unsigned start = vpn * PAGE_SIZE;
+    unsigned end = start + PAGE_SIZE;
+    return codeSize > 0 && start >= codeAddr && end <= codeAddr + codeSize
+        && (initDataSize == 0 || end <= initDataAddr
+              || start >= initDataAddr + initDataSize)
+        && end <= codeSize + initDataSize;
+}
+
+bool
+AddressSpace::HasBackingStore(unsigned vpn) const
+{
+    if (swapSlots[vpn] != -1) {
+        return true;
+    }
+    unsigned start = vpn * PAGE_SIZE;
+    unsigned end = start + PAGE_SIZE;
+    return (start < codeAddr + codeSize && codeAddr < end)
+        || (start < initDataAddr + initDataSize && initDataAddr < end);
+}
+
+/// The first fault of a run brings in nothing else; each fault at the page
+/// following the last one brought in doubles the number of pages brought
+/// in ahead, up to `faultAroundWindow`.  Pages are loaded before the one
+/// that faulted, so that they cannot make it be evicted.  Pages that would
+/// be filled with zeros are left to fault, since loading them costs no I/O.
+///
+/// Pages brought in are marked as used, so that clock policies do not
+/// evict them before they are reached.  They are only entered in the page
+/// table: loading them into the TLB would evict live entries for pages
+/// that may never be reached, and reaching them costs a TLB miss but no
+/// page fault.
+void
+AddressSpace::FaultAround(unsigned vpn)
+{
+    if (faultAroundWindow == 0) {
+        return;
+    }
+
+    if (vpn != 0 && vpn == expectedFault) {
+        faultAroundPages = faultAroundPages == 0 ? 1 : 2 * faultAroundPages;
+        if (faultAroundPages > faultAroundWindow) {
+            faultAroundPages = faultAroundWindow;
+        }
+    } else {
+        faultAroundPages = 0;
+    }
+
+    unsigned next = vpn + 1;
+    for (; next < numPages && next <= vpn + faultAroundPages; next++) {
+        if (pageTable[next].valid) {
+            continue;
+        }
+        if (!HasBackingStore(next)) {
             break;
         }
+        DEBUG('p', "Bringing in page %u ahead of time\n", next);
+        bool loaded = swapSlots[next] != -1 ? ReadFromSwap(next)
+                                            : LoadPage(next);
+        if (!loaded) {
+            break;  // Only the faulting page has to be brought in.
+        }
+        pageTable[next].use = true;
+        stats->numPagesPrefetched++;
     }
+    while (next < numPages && pageTable[next].valid) {
+        next++;
+    }
+    expectedFault = next;
+}
 
+/// Copy-on-write pages are left alone: their frame or their slot may be
+/// shared with another space.
+int
+AddressSpace::CleanPage(unsigned vpn, int hint)
+{
+    TranslationEntry *entry = SyncPageBits(vpn);
+    if (!entry->valid || !entry->dirty || copyOnWrite[vpn]) {
+        return -1;
+    }
+
+    if (swapSlots[vpn] != -1 && swapArea->IsShared(swapSlots[vpn])) {
+        swapArea->Free(swapSlots[vpn]);
+        swapSlots[vpn] = -1;
+    }
+    if (swapSlots[vpn] == -1) {
+        int neighbour = NeighbourSlot(vpn);
+        swapSlots[vpn] = swapArea->Allocate(neighbour != -1 ? neighbour
+                                                            : hint);
+        if (swapSlots[vpn] == -1) {
+            return -1;  // The page stays dirty, for eviction to deal with.
+        }
+    }
+
+    entry->dirty = false;
+#ifdef USE_TLB
+    int i = FindTlbEntry(vpn);
+    if (i != -1) {
+        machine->GetMMU()->tlb[i].dirty = false;
+    }
+#endif
+    return swapSlots[vpn];
+}
+
+unsigned
+AddressSpace::SwapSlotsNeeded(unsigned vpn)
+{
+    if (!SyncPageBits(vpn)->dirty) {
+        return 0;
+    }
+    return swapSlots[vpn] == -1 || swapArea->IsShared(swapSlots[vpn]);
 }
-#endif
\ No newline at end of file
+
+TranslationEntry *
+AddressSpace::SyncPageBits(unsigned vpn)
+{
+    ASSERT(vpn < numPages);
+
+    TranslationEntry *entry = &pageTable[vpn];
+#ifdef USE_TLB
+    int i = FindTlbEntry(vpn);
+    if (i != -1) {
+        TranslationEntry *tlb = machine->GetMMU()->tlb;
+        entry->use = entry->use || tlb[i].use;
+        entry->dirty = entry->dirty || tlb[i].dirty;
+        tlb[i].use = false;
+    }
+#endif
+    return entry;
+}
+#endif
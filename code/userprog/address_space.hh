@@ -15,6 +15,7 @@
 
 
 #include "filesys/file_system.hh"
+#include "machine/mmu.hh"
 #include "machine/translation_entry.hh"
 #include "executable.hh"
 #include "lib/bitmap.hh"
@@ -38,9 +39,22 @@ public:
     ///   program; it contains the object code to load into memory.
     AddressSpace(OpenFile *executable_file, int pid);
 
+    /// Create a duplicate of `parent`, for the `Fork` system call.
+    ///
+    /// With virtual memory, both spaces share their frames and swap slots
+    /// copy-on-write, so that creating the duplicate copies no page;
+    /// otherwise every page in memory is copied.
+    explicit AddressSpace(AddressSpace *parent);
+
     /// De-allocate an address space.
     ~AddressSpace();
 
+    /// Is there an address space identifier left for one more space?
+    ///
+    /// `Exec` and `Fork` fail when there is not, rather than create a
+    /// space that cannot be told apart in the TLB.
+    static bool CanCreate();
+
     /// Initialize user-level CPU registers, before jumping to user code.
     void InitRegisters();
 
@@ -49,38 +63,170 @@ public:
     void SaveState();
     void RestoreState();
 
+    /// Remove every TLB entry of this address space.
     void InvalidateTLB();
-    void SavePageFromTLB(unsigned page);
+
+    /// Save the use and dirty bits of TLB entry `page` into the page table
+    /// of the address space that loaded it, and invalidate the entry.
+    ///
+    /// The `use` bit of the page is only ever set here, since a TLB
+    /// replacement policy may have cleared it in the TLB.
+    static void SavePageFromTLB(unsigned page);
+
+    /// Clear the `use` bit of TLB entry `page`, after saving it into the
+    /// page table of the address space that loaded it.
+    static void ClearTlbUse(unsigned page);
+
     bool SetTlbPage(TranslationEntry *pageTranslation);
+
+    /// Return the page table entry of page `vpn`, bringing the page into
+    /// memory first if needed.  Return null if no frame could be found for
+    /// the page.
     TranslationEntry* GetTranslationEntry(unsigned vpn);
 
+    /// Bring in page `vpn` after a page fault on it, and load its
+    /// translation into the TLB.
+    ///
+    /// Return false if no frame could be found for the page; the process
+    /// must then exit, as told by `IsOutOfMemory`.
+    bool HandlePageFault(unsigned vpn);
+
+    /// Did a page fault or a copy-on-write find no memory for a page of
+    /// this space?
+    bool IsOutOfMemory() const;
+
     // Demand Loading
-    void LoadPage(unsigned vpn);
+    /// Load page `vpn` from the executable.  Return false if no frame
+    /// could be found for it.
+    bool LoadPage(unsigned vpn);
+
+    /// Handle a write to read-only page `vpn`.
+    ///
+    /// If the page is shared with another space since a `Fork`, or mapped
+    /// to the zero frame, give it a frame of its own if needed, make it
+    /// writable and return true.  Otherwise the page is really read-only:
+    /// return false.  Also return false if no frame can be found for the
+    /// copy, as told by `IsOutOfMemory`.
+    bool CopyOnWrite(unsigned vpn);
 
     // Swap
-    void ReadFromSwap(unsigned vpn);
+    /// Bring page `vpn` in from swap.  Return false if no frame could be
+    /// found for it.
+    bool ReadFromSwap(unsigned vpn);
     void WriteToSwap(unsigned vpn);
 
+#ifdef SWAP
+    /// Maximum number of pages brought in ahead of a page fault, once the
+    /// faults of an address space are found to be sequential.  Zero
+    /// disables fault-around.
+    static unsigned faultAroundWindow;
+
+    /// Merge the `use` and `dirty` bits that the TLB holds for resident
+    /// page `vpn` into the page table, and return its entry.
+    ///
+    /// The `use` bit is cleared in the TLB, so that clearing it in the
+    /// returned entry starts a new reference period for the page.
+    TranslationEntry *SyncPageBits(unsigned vpn);
+
+    /// Prepare resident page `vpn` to be written back to swap while it
+    /// stays mapped, and return the slot it must be written to, or -1 if
+    /// the page is clean or cannot be written back now.
+    ///
+    /// The page gets a slot of its own (slot `hint` if it is free and the
+    /// page has no better one) and is marked clean, so the caller must
+    /// write it before the page can be used again.
+    int CleanPage(unsigned vpn, int hint);
+
+    /// Return the number of swap slots that writing resident page `vpn`
+    /// to swap would take: one if it is dirty and has no slot of its own,
+    /// none otherwise.
+    unsigned SwapSlotsNeeded(unsigned vpn);
+#endif
+
 private:
 
+#ifdef USE_TLB
+    /// Return the TLB entry that this space loaded for page `vpn`, or -1
+    /// if there is none.
+    int FindTlbEntry(unsigned vpn) const;
+#endif
+
+#ifdef SWAP
+    /// Return the swap slot page `vpn` would best be written to, or -1.
+    int NeighbourSlot(unsigned vpn) const;
+
+    /// Does page `vpn` hold only code, so that it can be shared with other
+    /// address spaces running the same executable?
+    bool IsCodePage(unsigned vpn) const;
+
+    /// Is page `vpn` in swap or backed by the executable?
+    bool HasBackingStore(unsigned vpn) const;
+
+    /// Bring in the pages following `vpn` that are not in memory, if the
+    /// faults look sequential.
+    void FaultAround(unsigned vpn);
+#endif
+
     /// Assume linear page table translation for now!
     TranslationEntry *pageTable;
 
     /// Number of pages in the virtual address space.
     unsigned numPages;
 
-    /// TLB index in this address space
-    unsigned int tlbIndex;
+    /// Set when a page could not be brought into memory, so that the
+    /// process exits once it holds nothing else.
+    bool outOfMemory;
+
+    /// Address space identifier, which tags the TLB entries of this space
+    /// so that they can stay in the TLB while other spaces run.
+    unsigned asid;
+
+    /// Identifiers of the address spaces alive.  An identifier is given to
+    /// a new space once the TLB entries of its previous owner are flushed.
+    static Bitmap usedAsids;
+
+    /// Return an identifier not used by any other address space.  One
+    /// must be free, as checked with `CanCreate`.
+    static unsigned AllocateAsid();
+
+#ifdef USE_TLB
+    /// Value of `stats->numPageHits` when this space was last restored.
+    unsigned long hitsOnRestore;
+
+    /// Address space that loaded each TLB entry.
+    static AddressSpace *tlbOwners[TLB_SIZE];
+#endif
 
     // Demand Loading
     OpenFile* executable;
+
+    /// Number of address spaces sharing `executable`, which is closed by
+    /// the last of them.
+    unsigned *executableUsers;
+
     unsigned int codeSize, codeAddr;
     unsigned int initDataSize, initDataAddr;
 
     // Swap
-    char* swapName;
-    OpenFile* swapFile;
-    Bitmap* inSwap;
+#ifdef SWAP
+    /// Slot of the shared swap area holding each page, or -1 if the page
+    /// was never written to swap.
+    int *swapSlots;
+
+    /// Page the next fault is expected at, if accesses are sequential.
+    unsigned expectedFault;
+
+    /// Pages brought in ahead of the last fault.
+    unsigned faultAroundPages;
+
+    /// Identifies the executable, so that its code pages can be shared.
+    unsigned long executableId;
+
+    /// Pages that are read-only only because they are shared with another
+    /// space since a `Fork`, or mapped to the zero frame, and that get
+    /// copied when written to.
+    bool *copyOnWrite;
+#endif
 
 };
 
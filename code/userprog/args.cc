@@ -4,6 +4,7 @@
 
 
 #include "transfer.hh"
+#include "machine/endianness.hh"
 #include "machine/machine.hh"
 #include "threads/system.hh"
 
@@ -13,10 +14,32 @@
 static const unsigned MAX_ARG_COUNT  = 32;
 static const unsigned MAX_ARG_LENGTH = 128;
 
+/// Read the word at user address `address` into `value`.
+///
+/// User memory is accessed through `transfer.hh`, so that running out of
+/// memory for its pages is reported rather than raised as an exception.
+static inline
+bool ReadWordFromUser(int address, int *value)
+{
+    if (!ReadBufferFromUser(address, (char *) value, sizeof *value)) {
+        return false;
+    }
+    *value = WordToHost(*value);
+    return true;
+}
+
+/// Write `value` as a word at user address `address`.
+static inline
+bool WriteWordToUser(int address, int value)
+{
+    value = WordToMachine(value);
+    return WriteBufferToUser((const char *) &value, address, sizeof value);
+}
+
 /// Count the number of arguments up to a null (which is not counted).
 ///
 /// Returns true if the number fit in the established limits and false if
-/// too many arguments were provided.
+/// too many arguments were provided, or if they could not be read.
 static inline
 bool CountArgsToSave(int address, unsigned *count)
 {
@@ -26,7 +49,9 @@ bool CountArgsToSave(int address, unsigned *count)
     int val;
     unsigned c = 0;
     do {
-        machine->ReadMem(address + 4 * c, 4, &val);
+        if (!ReadWordFromUser(address + 4 * c, &val)) {
+            return false;
+        }
         c++;
     } while (c < MAX_ARG_COUNT && val != 0);
     if (c == MAX_ARG_COUNT && val != 0) {
@@ -60,11 +85,20 @@ SaveArgs(int address)
         args[i] = new char [MAX_ARG_LENGTH];
         int strAddr;
         // For each pointer, read the corresponding string.
-        machine->ReadMem(address + i * 4, 4, &strAddr);
-        ReadStringFromUser(strAddr, args[i], MAX_ARG_LENGTH);
+        if (ReadWordFromUser(address + i * 4, &strAddr)) {
+            ReadStringFromUser(strAddr, args[i], MAX_ARG_LENGTH);
+        }
     }
     args[count] = nullptr;  // Write the trailing null.
 
+    if (currentThread->space->IsOutOfMemory()) {
+        for (unsigned i = 0; i < count; i++) {
+            delete [] args[i];
+        }
+        delete [] args;
+        return nullptr;
+    }
+
     return args;
 }
 
@@ -97,9 +131,9 @@ WriteArgs(char **args)
     sp -= c * 4 + 4;  // Make room for `argv`, including the trailing null.
     // Write each argument's address.
     for (unsigned i = 0; i < c; i++) {
-        machine->WriteMem(sp + 4 * i, 4, argsAddress[i]);
+        WriteWordToUser(sp + 4 * i, argsAddress[i]);
     }
-    machine->WriteMem(sp + 4 * c, 4, 0);  // The last is null.
+    WriteWordToUser(sp + 4 * c, 0);  // The last is null.
 
     machine->WriteRegister(STACK_REG, sp);
     return c;
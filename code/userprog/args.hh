@@ -19,6 +19,9 @@
 /// Parameters:
 /// * `address` is a user-space address pointing to the start of an
 ///   `argv`-like array.
+///
+/// Return null if there are too many arguments, or if they could not be
+/// read for lack of memory (see `AddressSpace::IsOutOfMemory`).
 char **SaveArgs(int address);
 
 /// Write command-line arguments into the stack memory of a user process.
@@ -60,7 +63,9 @@ char **SaveArgs(int address);
 /// * `args` is a kernel-space pointer to the start of an `argv`-like array.
 ///
 /// Returns the count of arguments, not including the trailing null (the
-/// same as `argc`).  Frees everything allocated by `SaveArgs`.
+/// same as `argc`).  Frees everything allocated by `SaveArgs`.  If the
+/// process runs out of memory meanwhile, the arguments are left unfinished
+/// and the caller must check `AddressSpace::IsOutOfMemory`.
 unsigned WriteArgs(char **args);
 
 
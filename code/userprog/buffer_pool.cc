@@ -0,0 +1,55 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "buffer_pool.hh"
+#include "lib/assert.hh"
+
+
+BufferPool::BufferPool(unsigned count, unsigned size_)
+{
+    ASSERT(count > 0);
+    ASSERT(size_ > 0);
+
+    size = size_;
+    memory = new char[count * size];
+    freeBuffers = new char*[count];
+    for (unsigned i = 0; i < count; i++) {
+        freeBuffers[i] = memory + i * size;
+    }
+    numFree = count;
+    available = new Semaphore("buffer pool", count);
+}
+
+BufferPool::~BufferPool()
+{
+    delete available;
+    delete [] freeBuffers;
+    delete [] memory;
+}
+
+/// The pop cannot be interrupted: context switches only happen when
+/// interrupts are re-enabled, as in `Semaphore::P`.
+char *
+BufferPool::Take()
+{
+    available->P();
+    ASSERT(numFree > 0);
+    return freeBuffers[--numFree];
+}
+
+void
+BufferPool::Give(char *buffer)
+{
+    ASSERT(buffer != nullptr);
+
+    freeBuffers[numFree++] = buffer;
+    available->V();
+}
+
+unsigned
+BufferPool::GetSize() const
+{
+    return size;
+}
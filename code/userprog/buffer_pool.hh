@@ -0,0 +1,62 @@
+/// A pool of fixed-size kernel buffers for moving data between files and
+/// user memory.
+///
+/// `Read` and `Write` system calls of any size go through one of these
+/// buffers a chunk at a time, so that the kernel memory they take is
+/// bounded and does not come from the stack of the calling thread.
+/// Console reads, which can wait indefinitely for input, do not take one.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_BUFFERPOOL__HH
+#define NACHOS_USERPROG_BUFFERPOOL__HH
+
+
+#include "threads/semaphore.hh"
+
+
+/// Number of bytes in each buffer of the pool.
+const unsigned IO_BUFFER_SIZE = 512;
+
+/// Number of buffers in the pool, which bounds the number of transfers in
+/// progress at once.
+const unsigned NUM_IO_BUFFERS = 4;
+
+
+class BufferPool {
+public:
+
+    /// Allocate `count` buffers of `size` bytes.
+    BufferPool(unsigned count, unsigned size);
+
+    ~BufferPool();
+
+    /// Take a buffer, waiting for one to be given back if all of them are
+    /// in use.
+    char *Take();
+
+    /// Give back a buffer obtained from `Take`.
+    void Give(char *buffer);
+
+    /// Return the size of the buffers.
+    unsigned GetSize() const;
+
+private:
+
+    char *memory;
+
+    unsigned size;
+
+    /// Buffers not in use, as a stack of `numFree` entries.
+    char **freeBuffers;
+    unsigned numFree;
+
+    /// Counts the buffers not in use.
+    Semaphore *available;
+
+};
+
+
+#endif
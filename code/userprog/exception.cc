@@ -26,11 +26,25 @@
 #include "syscall.h"
 #include "filesys/directory_entry.hh"
 #include "threads/system.hh"
+#include "machine/endianness.hh"
 #include "args.hh"
 
 #include <stdio.h>
 
 
+/// Terminate the current process, as `Exit` does, because a page of it
+/// could not be brought into memory.
+///
+/// Must only be called when the kernel holds nothing on behalf of the
+/// process.
+static void
+ExitOutOfMemory()
+{
+    fprintf(stderr, "Out of memory, terminating %s\n",
+            currentThread->GetName());
+    currentThread->Finish(-1);
+}
+
 void
 InitProcess(void* args)
 {
@@ -39,6 +53,9 @@ InitProcess(void* args)
 
     if (args != nullptr) {
         unsigned argc = WriteArgs((char**)args);
+        if (currentThread->space->IsOutOfMemory()) {
+            ExitOutOfMemory();
+        }
         machine->WriteRegister(4, argc);
 
         int space = machine->ReadRegister(STACK_REG);
@@ -49,6 +66,21 @@ InitProcess(void* args)
     machine->Run();  // Jump to the user progam.
 }
 
+/// Start running a process created by `Fork`, from the registers that its
+/// parent had when it called `Fork`.
+static void
+ForkedProcess(void *args)
+{
+    int *registers = (int *) args;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, registers[i]);
+    }
+    delete [] registers;
+    currentThread->space->RestoreState();
+
+    machine->Run();
+}
+
 static void
 IncrementPC()
 {
@@ -80,6 +112,160 @@ DefaultHandler(ExceptionType et)
     ASSERT(false);
 }
 
+/// Find the file that open file `fid` of the current thread reads or writes
+/// (depending on `writing`), and store it in `file`; the console is given
+/// as null.  Return false if there is no such file.
+static bool
+LookUpFile(OpenFileId fid, bool writing, OpenFile **file)
+{
+    ASSERT(file != nullptr);
+
+    *file = nullptr;
+    if (fid == (writing ? CONSOLE_OUTPUT : CONSOLE_INPUT)) {
+        DEBUG('e', "%s the console.\n",
+              writing ? "Writing to" : "Reading from");
+        return true;
+    }
+    if (fid == (writing ? CONSOLE_INPUT : CONSOLE_OUTPUT) || fid < 0) {
+        DEBUG('e', "Error: Invalid file for %s.\n",
+              writing ? "writing" : "reading");
+        return false;
+    }
+    if (!currentThread->filesTable->HasKey(fid)) {
+        DEBUG('e', "File with id %u does not exists.\n", fid);
+        return false;
+    }
+    DEBUG('e', "%s file with id %u.\n",
+          writing ? "Writing to" : "Reading from", fid);
+    *file = currentThread->filesTable->Get(fid);
+    return true;
+}
+
+/// Number of bytes read from the console at a time.
+static const unsigned CONSOLE_READ_CHUNK = 128;
+
+/// Read `size` bytes into user memory at `userAddress`, from `file`, or
+/// from the console if `file` is null.  Read from `position` if it is not
+/// negative, and from the current position of the file otherwise.
+///
+/// File data goes through a pooled buffer, one chunk at a time, so that
+/// requests can be of any size.  Console reads may wait for a line for
+/// as long as it takes to type it, so they use a small buffer of their own
+/// instead of keeping a pooled buffer from other transfers.
+///
+/// Return the number of bytes read, which is less than `size` only at the
+/// end of the file, or of a line read from the console.
+static int
+ReadToUser(OpenFile *file, int userAddress, int size, int position)
+{
+    char consoleBuffer[CONSOLE_READ_CHUNK];
+    char *bufferSys = file == nullptr ? consoleBuffer : ioBuffers->Take();
+    int bufferSize = file == nullptr ? sizeof consoleBuffer
+                                     : ioBuffers->GetSize();
+    int bytesRead = 0;
+    while (bytesRead < size) {
+        int chunk = size - bytesRead;
+        if (chunk > bufferSize) {
+            chunk = bufferSize;
+        }
+        int count;
+        if (file == nullptr) {
+            count = synchConsole->ReadBuffer(bufferSys, chunk);
+        } else if (position >= 0) {
+            count = file->ReadAt(bufferSys, chunk, position + bytesRead);
+        } else {
+            count = file->Read(bufferSys, chunk);
+        }
+        if (count <= 0) {
+            break;
+        }
+        if (!WriteBufferToUser(bufferSys, userAddress + bytesRead, count)) {
+            break;  // Out of memory: the process is to exit.
+        }
+        bytesRead += count;
+        if (count < chunk
+              || (file == nullptr && bufferSys[count - 1] == '\n')) {
+            break;  // End of file, or of a line read from the console.
+        }
+    }
+    if (file != nullptr) {
+        ioBuffers->Give(bufferSys);
+    }
+    return bytesRead;
+}
+
+/// Write `size` bytes from user memory at `userAddress` to `file`, or to the
+/// console if `file` is null.  Write at `position` if it is not negative,
+/// and at the current position of the file otherwise.
+///
+/// Return the number of bytes written, which is less than `size` only if
+/// the file could not grow.
+static int
+WriteFromUser(OpenFile *file, int userAddress, int size, int position)
+{
+    char *bufferSys = ioBuffers->Take();
+    int bytesWritten = 0;
+    while (bytesWritten < size) {
+        int chunk = size - bytesWritten;
+        if (chunk > (int) ioBuffers->GetSize()) {
+            chunk = ioBuffers->GetSize();
+        }
+        if (!ReadBufferFromUser(userAddress + bytesWritten, bufferSys,
+                                chunk)) {
+            break;  // Out of memory: the process is to exit.
+        }
+        int count;
+        if (file == nullptr) {
+            synchConsole->WriteBuffer(bufferSys, chunk);
+            count = chunk;
+        } else if (position >= 0) {
+            count = file->WriteAt(bufferSys, chunk, position + bytesWritten);
+        } else {
+            count = file->Write(bufferSys, chunk);
+        }
+        if (count <= 0) {
+            break;
+        }
+        bytesWritten += count;
+        if (count < chunk) {
+            break;  // The file could not grow.
+        }
+    }
+    ioBuffers->Give(bufferSys);
+    return bytesWritten;
+}
+
+/// Copy the `count` segments of the `IoVec` array at `userAddress` into
+/// `segments`, as pairs of address and size.  Return false if `count` is
+/// out of range, a size is negative, or a segment that is not empty has
+/// no buffer.
+static bool
+ReadIoVecFromUser(int userAddress, int count, int *segments)
+{
+    if (userAddress == 0 || count <= 0 || count > MAX_IOVEC) {
+        DEBUG('e', "Error: Invalid segment array.\n");
+        return false;
+    }
+    if (!ReadBufferFromUser(userAddress, (char *) segments,
+                            count * 2 * sizeof *segments)) {
+        return false;
+    }
+    for (int i = 0; i < 2 * count; i++) {
+        segments[i] = WordToHost(segments[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        if (segments[2 * i + 1] < 0) {
+            DEBUG('e', "Error: Invalid size for segment %d.\n", i);
+            return false;
+        }
+        if (segments[2 * i] == 0 && segments[2 * i + 1] > 0) {
+            DEBUG('e', "Error: Invalid buffer for segment %d.\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
 /// Handle a system call exception.
 ///
 /// * `et` is the kind of exception.  The list of possible exceptions is in
@@ -105,6 +291,7 @@ SyscallHandler(ExceptionType _et)
 
         case SC_HALT:
             DEBUG('e', "Shutdown, initiated by user program.\n");
+            currentThread->space->SaveState();  // Account for its statistics.
             interrupt->Halt();
             break;
 
@@ -227,80 +414,126 @@ SyscallHandler(ExceptionType _et)
         }
 
         case SC_READ: {
-          int buffer = machine->ReadRegister(4);
-          int size = machine->ReadRegister(5);
-          OpenFileId fid = machine->ReadRegister(6);
-          int bytesRead = 0;
+            int buffer = machine->ReadRegister(4);
+            int size = machine->ReadRegister(5);
+            OpenFileId fid = machine->ReadRegister(6);
 
-          if (size <= 0) {
-            DEBUG('e',"Error: Invalid size.\n");
-            machine->WriteRegister(2, -1);
-            break;
-          } 
-          char bufferSys[size];
-          if (fid == CONSOLE_OUTPUT || fid < 0) {
-            DEBUG('e', "Error: Invalid file for reading.\n");
-            machine->WriteRegister(2,-1);
-            break;
-          } else if(fid == CONSOLE_INPUT) {
-                DEBUG('e', "Reading from console.\n");
-                synchConsole->ReadBuffer(bufferSys, size);
-                bytesRead = size;
-                WriteBufferToUser(bufferSys, buffer, bytesRead);
-            } else {
-                if (currentThread->filesTable->HasKey(fid)) {
-                    DEBUG('e', "Reading from file with id %u.\n", fid);
-                    OpenFile *file = currentThread->filesTable->Get(fid);
-                    bytesRead = file->Read(bufferSys, size);
-                    if (bytesRead > 0) {
-                        WriteBufferToUser(bufferSys, buffer, bytesRead);
-                    }
-            } else {
-                DEBUG('e', "File with id %u does not exists.\n", fid);
+            if (size <= 0) {
+                DEBUG('e', "Error: Invalid size.\n");
                 machine->WriteRegister(2, -1);
                 break;
             }
-          }
-          machine->WriteRegister(2, bytesRead);
-
-          break;
+            OpenFile *file;
+            if (!LookUpFile(fid, false, &file)) {
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            machine->WriteRegister(2, ReadToUser(file, buffer, size, -1));
+            break;
         }
-        
+
         case SC_WRITE: {
-          int buffer = machine->ReadRegister(4);
-          int size = machine->ReadRegister(5);
-          OpenFileId fid = machine->ReadRegister(6);
-          int bytesWrite = 0;
+            int buffer = machine->ReadRegister(4);
+            int size = machine->ReadRegister(5);
+            OpenFileId fid = machine->ReadRegister(6);
 
-          if (size <= 0) {
-            DEBUG('e',"Error: Invalid size.\n");
-            machine->WriteRegister(2, -1);
+            if (size <= 0) {
+                DEBUG('e', "Error: Invalid size.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            OpenFile *file;
+            if (!LookUpFile(fid, true, &file)) {
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            machine->WriteRegister(2, WriteFromUser(file, buffer, size, -1));
             break;
-          } 
-          char bufferSys[size];
-          if (fid == CONSOLE_INPUT || fid < 0) {
-            DEBUG('e', "Error: Invalid file for writing.\n");
-            machine->WriteRegister(2,-1);
+        }
+
+        case SC_READV: {
+            int vector = machine->ReadRegister(4);
+            int count = machine->ReadRegister(5);
+            OpenFileId fid = machine->ReadRegister(6);
+
+            int segments[2 * MAX_IOVEC];
+            OpenFile *file;
+            if (!ReadIoVecFromUser(vector, count, segments)
+                  || !LookUpFile(fid, false, &file)) {
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            DEBUG('e', "Reading %d segments.\n", count);
+
+            // Segments are filled in order; a short read ends the transfer.
+            int bytesRead = 0;
+            for (int i = 0; i < count; i++) {
+                int size = segments[2 * i + 1];
+                int n = ReadToUser(file, segments[2 * i], size, -1);
+                bytesRead += n;
+                if (n < size) {
+                    break;
+                }
+            }
+            machine->WriteRegister(2, bytesRead);
             break;
-          } else if(fid == CONSOLE_OUTPUT) {
-                DEBUG('e', "writing to console.\n");
-                ReadBufferFromUser(buffer, bufferSys, size);
-                synchConsole->WriteBuffer(bufferSys, size);
-                bytesWrite = size;
-          } else {
-              if (currentThread->filesTable->HasKey(fid)){
-                DEBUG('e', "Writing to file with id %u.\n", fid);
-                OpenFile *file = currentThread->filesTable->Get(fid);
-                ReadBufferFromUser(buffer, bufferSys, size);
-                bytesWrite = file->Write(bufferSys, size);
-              } else {
-                DEBUG('e', "File with id %u does not exists.\n", fid);
+        }
+
+        case SC_WRITEV: {
+            int vector = machine->ReadRegister(4);
+            int count = machine->ReadRegister(5);
+            OpenFileId fid = machine->ReadRegister(6);
+
+            int segments[2 * MAX_IOVEC];
+            OpenFile *file;
+            if (!ReadIoVecFromUser(vector, count, segments)
+                  || !LookUpFile(fid, true, &file)) {
                 machine->WriteRegister(2, -1);
                 break;
+            }
+            DEBUG('e', "Writing %d segments.\n", count);
+
+            int bytesWritten = 0;
+            for (int i = 0; i < count; i++) {
+                int size = segments[2 * i + 1];
+                int n = WriteFromUser(file, segments[2 * i], size, -1);
+                bytesWritten += n;
+                if (n < size) {
+                    break;
                 }
             }
-            machine->WriteRegister(2, bytesWrite);
+            machine->WriteRegister(2, bytesWritten);
+            break;
+        }
+
+        case SC_PREAD:
+        case SC_PWRITE: {
+            bool writing = scid == SC_PWRITE;
+            int buffer = machine->ReadRegister(4);
+            int size = machine->ReadRegister(5);
+            int position = machine->ReadRegister(6);
+            OpenFileId fid = machine->ReadRegister(7);
 
+            if (size <= 0 || position < 0) {
+                DEBUG('e', "Error: Invalid size or position.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            OpenFile *file;
+            if (!LookUpFile(fid, writing, &file)) {
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            if (file == nullptr) {
+                DEBUG('e', "Error: The console has no positions.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            DEBUG('e', "%s %d bytes at position %d.\n",
+                  writing ? "Writing" : "Reading", size, position);
+            machine->WriteRegister(2, writing
+                ? WriteFromUser(file, buffer, size, position)
+                : ReadToUser(file, buffer, size, position));
             break;
         }
 
@@ -342,20 +575,62 @@ SyscallHandler(ExceptionType _et)
                 machine->WriteRegister(2, -1);
                 break;
             }
+            if (!AddressSpace::CanCreate()) {
+                DEBUG('e', "'Exec' Error: Too many address spaces.\n");
+                delete execFile;
+                machine->WriteRegister(2, -1);
+                break;
+            }
 
-            Thread* child = new Thread(filename, joinable, currentThread->GetPriority());
-            child->space = new AddressSpace(execFile, currentThread->spaceId);
-
+            // The arguments are read before the child is created, so that
+            // nothing is left half made if they cannot be.
             char **argv = nullptr;
             if (argvAddr) {
                 argv = SaveArgs(argvAddr);
+                if (currentThread->space->IsOutOfMemory()) {
+                    delete execFile;
+                    break;
+                }
             }
+
+            Thread* child = new Thread(filename, joinable, currentThread->GetPriority());
+            child->space = new AddressSpace(execFile, currentThread->spaceId);
             child->Fork(InitProcess, argv);
 
             machine->WriteRegister(2, child->spaceId);
             break;
         }
 
+        case SC_FORK: {
+            bool joinable = machine->ReadRegister(4);
+            DEBUG('e', "`Fork` requested by thread %s.\n",
+                  currentThread->GetName());
+            if (!AddressSpace::CanCreate()) {
+                DEBUG('e', "`Fork` Error: Too many address spaces.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+
+            Thread *child = new Thread(currentThread->GetName(), joinable,
+                                       currentThread->GetPriority());
+            child->space = new AddressSpace(currentThread->space);
+
+            // The child goes on after the system call, which returns 0 to
+            // it.
+            int *registers = new int[NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+                registers[i] = machine->ReadRegister(i);
+            }
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] += 4;
+            registers[2] = 0;
+            child->Fork(ForkedProcess, registers);
+
+            machine->WriteRegister(2, child->spaceId);
+            break;
+        }
+
         case SC_STATE: {
             DEBUG('e',"Scheduler state.\n");
             scheduler->Print();
@@ -367,6 +642,13 @@ SyscallHandler(ExceptionType _et)
             ASSERT(false);
     }
 
+    // A transfer of user memory found no frame for a page.  It gave up,
+    // and the call released what it held on its way out, so the process
+    // can exit as with `Exit`.
+    if (currentThread->space->IsOutOfMemory()) {
+        ExitOutOfMemory();
+    }
+
     IncrementPC();
 
 }
@@ -380,11 +662,11 @@ PageFaultHandler (ExceptionType _et)
     DEBUG('e', "Page fault in thread %s, virtual page %u, badVAddr %u\n",
          currentThread->GetName(), vpn, badVAddr);
     
-    TranslationEntry *entry = currentThread->space->GetTranslationEntry(vpn);
-
-    currentThread->space->SetTlbPage(entry);
-
-    stats->numPageFaults++;
+    if (!currentThread->space->HandlePageFault(vpn)) {
+        // The fault came from user code, so the kernel holds nothing for
+        // the process.
+        ExitOutOfMemory();
+    }
 }
 
 static void
@@ -392,6 +674,12 @@ ReadOnlytHandler (ExceptionType _et)
 {
     unsigned badVAddr = machine->ReadRegister(BAD_VADDR_REG);
     unsigned int numPage = badVAddr / PAGE_SIZE;
+    if (currentThread->space->CopyOnWrite(numPage)) {
+        return;  // The write is retried, now that the page is writable.
+    }
+    if (currentThread->space->IsOutOfMemory()) {
+        ExitOutOfMemory();
+    }
     fprintf(stderr, "'Page 'ReadOnly' exception'. Virtual address: %d -- Page: %d\n", badVAddr, numPage);
     currentThread->Finish(_et);
 }
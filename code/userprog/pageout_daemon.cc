@@ -0,0 +1,58 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "pageout_daemon.hh"
+#include "threads/system.hh"
+
+
+#ifdef SWAP
+
+static void
+PageoutThread(void *daemon)
+{
+    ((PageoutDaemon *) daemon)->Run();
+}
+
+PageoutDaemon::PageoutDaemon()
+{
+    wakeUp = new Semaphore("pageout", 0);
+    pending = false;
+    thread = new Thread("pageout", false, 0, true);
+    thread->Fork(PageoutThread, this);
+}
+
+/// Nachos is halting, so the daemon thread will never run again; it goes
+/// before the semaphore it may be blocked on.  If it was woken up and did
+/// not run yet, it is still on the ready list, and has to be taken off.
+PageoutDaemon::~PageoutDaemon()
+{
+    scheduler->Remove(thread);
+    delete thread;
+    delete wakeUp;
+}
+
+void
+PageoutDaemon::Check()
+{
+    if (!pending && coreMap->CountClear() + coreMap->CountCleanAhead()
+                      < PAGEOUT_LOW_WATER) {
+        pending = true;
+        wakeUp->V();
+    }
+}
+
+void
+PageoutDaemon::Run()
+{
+    for (;;) {
+        wakeUp->P();
+        pending = false;
+        DEBUG('p', "Pageout daemon running, %d frames free\n",
+              coreMap->CountClear());
+        stats->numPageoutWrites += coreMap->CleanAhead(PAGEOUT_HIGH_WATER);
+    }
+}
+
+#endif
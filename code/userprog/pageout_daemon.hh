@@ -0,0 +1,60 @@
+/// Kernel thread that writes dirty pages back to swap ahead of time.
+///
+/// Without it, a page fault that finds memory full has to wait for its
+/// victim to be written to swap if it is dirty.  The daemon is woken up
+/// when fewer than `PAGEOUT_LOW_WATER` frames are free or known to be
+/// clean, and then writes back the dirty pages among the next
+/// `PAGEOUT_HIGH_WATER` victims of the replacement policy, in as few
+/// transfers as it can.  The pages stay mapped; faults still evict them,
+/// but find them clean.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_PAGEOUTDAEMON__HH
+#define NACHOS_USERPROG_PAGEOUTDAEMON__HH
+
+
+#include "threads/semaphore.hh"
+#include "threads/thread.hh"
+
+
+/// Free or clean frames below which the daemon is woken up.
+const unsigned PAGEOUT_LOW_WATER = 2;
+
+/// Clean victims the daemon stops at.
+const unsigned PAGEOUT_HIGH_WATER = 8;
+
+
+class PageoutDaemon {
+public:
+
+    /// Fork the daemon thread.
+    PageoutDaemon();
+
+    ~PageoutDaemon();
+
+    /// Wake the daemon up if free and clean frames are running low.
+    ///
+    /// Must only be called where a context switch is safe, since the
+    /// daemon may run right away.
+    void Check();
+
+    /// Body of the daemon thread.
+    void Run();
+
+private:
+
+    Thread *thread;
+
+    /// Signalled when the daemon has work to do.
+    Semaphore *wakeUp;
+
+    /// Whether the daemon was signalled and did not run yet.
+    bool pending;
+
+};
+
+
+#endif
@@ -0,0 +1,178 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_area.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+
+#ifdef SWAP
+
+SwapArea::SwapArea(const char *name_, unsigned numSlots_)
+{
+    ASSERT(name_ != nullptr);
+    ASSERT(numSlots_ > 0);
+
+    name = name_;
+    numSlots = numSlots_;
+    numUsed = 0;
+    cursor = 0;
+    slots = new Bitmap(numSlots);
+    holders = new unsigned[numSlots];
+    ASSERT(fileSystem->Create(name, numSlots * PAGE_SIZE));
+    file = fileSystem->Open(name);
+    ASSERT(file != nullptr);
+    DEBUG('p', "Swap area `%s` created with %u slots\n", name, numSlots);
+}
+
+SwapArea::~SwapArea()
+{
+    delete file;
+    fileSystem->Remove(name);
+    delete slots;
+    delete [] holders;
+}
+
+int
+SwapArea::Allocate(int hint)
+{
+    if (!MakeRoom(1)) {
+        return -1;
+    }
+    if (hint >= 0 && (unsigned) hint < numSlots && !slots->Test(hint)) {
+        slots->Mark(hint);
+        holders[hint] = 1;
+        numUsed++;
+        return hint;
+    }
+    for (unsigned i = 0; i < numSlots; i++) {
+        unsigned slot = (cursor + i) % numSlots;
+        if (!slots->Test(slot)) {
+            slots->Mark(slot);
+            holders[slot] = 1;
+            numUsed++;
+            cursor = (slot + 1) % numSlots;
+            return slot;
+        }
+    }
+    ASSERT(false);
+    return -1;
+}
+
+bool
+SwapArea::MakeRoom(unsigned count)
+{
+    while (numSlots - numUsed < count) {
+        if (!Grow()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// The new slots are taken from the end of the file, which is extended
+/// by writing its last page, so that reading any slot back succeeds.
+bool
+SwapArea::Grow()
+{
+    if (numSlots >= MAX_SWAP_SLOTS) {
+        DEBUG('p', "Swap area `%s` is full\n", name);
+        return false;
+    }
+    unsigned newNumSlots = numSlots * 2 > MAX_SWAP_SLOTS ? MAX_SWAP_SLOTS
+                                                         : numSlots * 2;
+
+    Bitmap *newSlots = new Bitmap(newNumSlots);
+    unsigned *newHolders = new unsigned[newNumSlots];
+    for (unsigned i = 0; i < numSlots; i++) {
+        if (slots->Test(i)) {
+            newSlots->Mark(i);
+            newHolders[i] = holders[i];
+        }
+    }
+    delete slots;
+    delete [] holders;
+    slots = newSlots;
+    holders = newHolders;
+
+    char page[PAGE_SIZE] = {};
+    ASSERT(file->WriteAt(page, PAGE_SIZE, (newNumSlots - 1) * PAGE_SIZE)
+             == (int) PAGE_SIZE);
+    cursor = numSlots;
+    DEBUG('p', "Swap area `%s` grown from %u to %u slots\n",
+          name, numSlots, newNumSlots);
+    numSlots = newNumSlots;
+    return true;
+}
+
+void
+SwapArea::Free(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(slots->Test(slot));
+
+    if (--holders[slot] == 0) {
+        slots->Clear(slot);
+        numUsed--;
+    }
+}
+
+void
+SwapArea::Share(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(slots->Test(slot));
+
+    holders[slot]++;
+}
+
+bool
+SwapArea::IsShared(unsigned slot) const
+{
+    ASSERT(slot < numSlots);
+    ASSERT(slots->Test(slot));
+
+    return holders[slot] > 1;
+}
+
+void
+SwapArea::ReadSlot(unsigned slot, char *into)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(into != nullptr);
+
+    ASSERT(file->ReadAt(into, PAGE_SIZE, slot * PAGE_SIZE)
+             == (int) PAGE_SIZE);
+    stats->numSwapReads++;
+    Transferred(1);
+}
+
+void
+SwapArea::WriteSlot(unsigned slot, const char *from)
+{
+    WriteSlots(slot, 1, from);
+}
+
+void
+SwapArea::WriteSlots(unsigned first, unsigned count, const char *from)
+{
+    ASSERT(count > 0 && first + count <= numSlots);
+    ASSERT(from != nullptr);
+
+    unsigned size = count * PAGE_SIZE;
+    ASSERT(file->WriteAt(from, size, first * PAGE_SIZE) == (int) size);
+    stats->numSwapWrites += count;
+    Transferred(count);
+}
+
+/// Only the first page of a transfer has to wait for the slot to be
+/// reached; the following ones come right after it.
+void
+SwapArea::Transferred(unsigned count)
+{
+    stats->swapTicks += SWAP_TIME + (count - 1) * ROTATION_TIME;
+}
+
+#endif
@@ -0,0 +1,102 @@
+/// A swap area shared by every address space.
+///
+/// The area is a single file divided into page-sized slots.  Address spaces
+/// take slots only for the pages they actually evict, and give them back
+/// when they are destroyed.  The area doubles whenever it runs out of
+/// slots, up to `MAX_SWAP_SLOTS`.  A slot can be shared by address spaces created
+/// with `Fork`, and is only freed when the last of them gives it back.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_SWAPAREA__HH
+#define NACHOS_USERPROG_SWAPAREA__HH
+
+
+#include "filesys/open_file.hh"
+#include "lib/bitmap.hh"
+
+
+/// Number of page slots the swap area starts with.
+const unsigned NUM_SWAP_SLOTS = 1024;
+
+/// Number of page slots the swap area can grow to.
+const unsigned MAX_SWAP_SLOTS = 65536;
+
+
+class SwapArea {
+public:
+
+    /// Create the file `name` to hold `numSlots` pages at first.
+    SwapArea(const char *name, unsigned numSlots);
+
+    /// Close and remove the swap file.
+    ~SwapArea();
+
+    /// Take a free slot and return its number.
+    ///
+    /// Slot `hint` is taken if it is free, so that neighbouring pages can
+    /// be kept in neighbouring slots; otherwise the next free slot after
+    /// the last one taken is used, so that pages evicted one after the
+    /// other also end up together.  Pass -1 for no hint.
+    ///
+    /// Return -1 if every slot is taken and the area cannot grow.
+    int Allocate(int hint);
+
+    /// Make sure that `count` slots can be taken, growing the area if
+    /// needed.  Return false if the area cannot grow that much.
+    bool MakeRoom(unsigned count);
+
+    /// Give slot `slot` back.  The slot is freed once every space sharing
+    /// it gave it back.
+    void Free(unsigned slot);
+
+    /// Let one more address space hold slot `slot`.
+    void Share(unsigned slot);
+
+    /// Is slot `slot` held by more than one address space?  It must not be
+    /// written to then.
+    bool IsShared(unsigned slot) const;
+
+    /// Copy the page stored in slot `slot` into `into`.
+    void ReadSlot(unsigned slot, char *into);
+
+    /// Store the page at `from` into slot `slot`.
+    void WriteSlot(unsigned slot, const char *from);
+
+    /// Store the `count` pages at `from`, one after the other, into the
+    /// slots starting at `first`, in a single transfer.
+    void WriteSlots(unsigned first, unsigned count, const char *from);
+
+private:
+
+    /// Account for the time taken by a transfer of `count` pages.
+    static void Transferred(unsigned count);
+
+    /// Double the number of slots.  Return false if the area is already
+    /// as large as it can be.
+    bool Grow();
+
+    const char *name;
+
+    OpenFile *file;
+
+    /// Slots in use.
+    Bitmap *slots;
+
+    /// Number of address spaces holding each slot in use.
+    unsigned *holders;
+
+    unsigned numSlots;
+
+    /// Number of slots in use.
+    unsigned numUsed;
+
+    /// Slot the search for a free one starts from.
+    unsigned cursor;
+
+};
+
+
+#endif
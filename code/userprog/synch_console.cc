@@ -1,4 +1,5 @@
 #include "synch_console.hh"
+#include "threads/system.hh"
 
 
 /// Dummy functions because C++ is weird about pointers to member functions.
@@ -25,6 +26,12 @@ SynchConsole::SynchConsole(const char *name)
     writeDone = new Semaphore("Write done synch console", 0);
     readLock = new Lock("Reading synch console lock");
     writeLock = new Lock("Writing synch console lock");
+    inputStart = inputCount = inputLines = 0;
+    outputStart = outputCount = 0;
+    inputStalled = false;
+    outputBusy = false;
+    readerWants = 0;
+    writerWaiting = false;
 }
 
 SynchConsole::~SynchConsole()
@@ -39,53 +46,124 @@ SynchConsole::~SynchConsole()
 void
 SynchConsole::ReadChar(char *c)
 {
-    readLock->Acquire();
-    readAvail->P();
-    *c = console->GetChar();
-    readLock->Release();
+    ReadBuffer(c, 1);
 }
 
 void
 SynchConsole::WriteChar(const char *c)
 {
-    writeLock->Acquire();
-    console->PutChar(*c);
-    writeDone->P();
-    writeLock->Release();
+    WriteBuffer(c, 1);
+}
+
+bool
+SynchConsole::InputReady(unsigned size) const
+{
+    return inputLines > 0 || inputCount >= size
+           || inputCount == CONSOLE_BUFFER_SIZE;
 }
 
 void
+SynchConsole::TakeInput()
+{
+    ASSERT(inputCount < CONSOLE_BUFFER_SIZE);
+
+    char c = console->GetChar();
+    inputRing[(inputStart + inputCount) % CONSOLE_BUFFER_SIZE] = c;
+    inputCount++;
+    if (c == '\n') {
+        inputLines++;
+    }
+}
+
+unsigned
 SynchConsole::ReadBuffer(char *buffer, unsigned size)
 {
+    ASSERT(buffer != nullptr);
+
     readLock->Acquire();
-    for (unsigned i = 0; i < size; i++) 
-    {
-      readAvail->P();
-      buffer[i] = console->GetChar();
+    // The rings are shared with the interrupt handlers.
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    while (!InputReady(size)) {
+        readerWants = size;
+        readAvail->P();
+    }
+
+    unsigned count = 0;
+    while (count < size && inputCount > 0) {
+        char c = inputRing[inputStart];
+        inputStart = (inputStart + 1) % CONSOLE_BUFFER_SIZE;
+        inputCount--;
+        buffer[count++] = c;
+        if (c == '\n') {
+            inputLines--;
+            break;
+        }
     }
+    if (inputStalled) {
+        inputStalled = false;
+        TakeInput();
+    }
+
+    interrupt->SetLevel(oldLevel);
     readLock->Release();
+    return count;
 }
 
 void
-SynchConsole::WriteBuffer(char *buffer, unsigned size) 
+SynchConsole::WriteBuffer(const char *buffer, unsigned size)
 {
+    ASSERT(buffer != nullptr);
+
     writeLock->Acquire();
-    for (unsigned i = 0; i < size; i++)
-    {
-        console->PutChar(buffer[i]);
-        writeDone->P();
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    unsigned written = 0;
+    while (written < size) {
+        while (written < size && outputCount < CONSOLE_BUFFER_SIZE) {
+            outputRing[(outputStart + outputCount) % CONSOLE_BUFFER_SIZE]
+              = buffer[written++];
+            outputCount++;
+        }
+        if (!outputBusy) {
+            outputBusy = true;
+            WriteDone();  // Start the device on the first character.
+        }
+        writerWaiting = true;
+        writeDone->P();  // Woken up once the ring is drained.
     }
+    interrupt->SetLevel(oldLevel);
     writeLock->Release();
 }
 
+/// Called by the device when a character arrives, with interrupts disabled.
 void
 SynchConsole::ReadAvail()
 {
-  readAvail->V();
+    if (inputCount == CONSOLE_BUFFER_SIZE) {
+        inputStalled = true;
+        return;
+    }
+    TakeInput();
+    if (readerWants > 0 && InputReady(readerWants)) {
+        readerWants = 0;
+        readAvail->V();
+    }
 }
 
+/// Called by the device when a character is written, with interrupts
+/// disabled, and by `WriteBuffer` to write the first one.
 void
 SynchConsole::WriteDone()
 {
-  writeDone->V();
-}
\ No newline at end of file
+    if (outputCount > 0) {
+        char c = outputRing[outputStart];
+        outputStart = (outputStart + 1) % CONSOLE_BUFFER_SIZE;
+        outputCount--;
+        console->PutChar(c);
+        return;
+    }
+    outputBusy = false;
+    if (writerWaiting) {
+        writerWaiting = false;
+        writeDone->V();
+    }
+}
@@ -5,6 +5,15 @@
 #include "threads/lock.hh"
 #include "threads/semaphore.hh"
 
+/// Size of the rings buffering console input and output.
+const unsigned CONSOLE_BUFFER_SIZE = 512;
+
+/// Synchronous access to the console, buffered in both directions.
+///
+/// Output is queued in a ring that the write-done interrupt drains one
+/// character after the other, so that a writer only sleeps once per
+/// buffer instead of once per character.  Input is gathered into another
+/// ring by the read interrupt, and handed out a line at a time.
 class SynchConsole {
 public:
 
@@ -18,11 +27,16 @@ public:
   // Write char to console
   void WriteChar(const char *c);
 
-  // Read buffer from console
-  void ReadBuffer(char *buffer, unsigned size);
+  /// Read up to `size` characters from the console into `buffer`, stopping
+  /// after a newline.  Wait until a whole line, or `size` characters, are
+  /// available.
+  ///
+  /// Return the number of characters read.
+  unsigned ReadBuffer(char *buffer, unsigned size);
 
-  // Write buffer to console 
-  void WriteBuffer(char *buffer, unsigned size);
+  /// Write `size` characters from `buffer` to the console, and return once
+  /// they are all out.
+  void WriteBuffer(const char *buffer, unsigned size);
 
   // Used by console to signal I/O completion.
   void ReadAvail();
@@ -32,9 +46,41 @@ private:
   Console *console;
   Semaphore *readAvail;
   Semaphore *writeDone;
-  Lock *readLock;  
+  Lock *readLock;
   Lock *writeLock;
-  
+
+  /// Characters read and not handed out yet, and characters waiting to be
+  /// written, in rings starting at `inputStart` and `outputStart`.
+  char inputRing[CONSOLE_BUFFER_SIZE];
+  unsigned inputStart;
+  unsigned inputCount;
+  char outputRing[CONSOLE_BUFFER_SIZE];
+  unsigned outputStart;
+  unsigned outputCount;
+
+  /// Number of newlines in `inputRing`.
+  unsigned inputLines;
+
+  /// Is a character left in the device because `inputRing` was full?  The
+  /// device reads nothing more until it is taken.
+  bool inputStalled;
+
+  /// Is the device writing a character?
+  bool outputBusy;
+
+  /// Number of characters the sleeping reader asked for, or 0 if no reader
+  /// is sleeping.
+  unsigned readerWants;
+
+  /// Is the writer sleeping until `outputRing` drains?
+  bool writerWaiting;
+
+  /// Can a reader asking for `size` characters be served?
+  bool InputReady(unsigned size) const;
+
+  /// Move the character the device holds into `inputRing`.
+  void TakeInput();
+
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -32,6 +32,13 @@
 #define SC_READ    14
 #define SC_WRITE   15
 #define SC_STATE   16
+#define SC_READV   17
+#define SC_WRITEV  18
+#define SC_PREAD   19
+#define SC_PWRITE  20
+
+/// Maximum number of segments moved by one `ReadV` or `WriteV`.
+#define MAX_IOVEC  16
 
 
 #ifndef IN_ASM
@@ -49,7 +56,7 @@
 void Halt();
 
 
-/// Address space control operations: `Exit`, `Exec`, and `Join`.
+/// Address space control operations: `Exit`, `Exec`, `Fork`, and `Join`.
 
 /// This user program is done (`status = 0` means exited normally).
 void Exit(int status);
@@ -61,25 +68,29 @@ typedef int SpaceId;
 /// address space identifier.
 SpaceId Exec(char *name, int joinable, char** argv);
 
+/// Create a copy of the calling user program, that goes on running from the
+/// return of `Fork`.  The copy shares the memory of the caller
+/// copy-on-write, and starts with only the console open.
+///
+/// Return 0 in the copy, and its address space identifier in the caller.
+/// Like with `Exec`, the copy can only be joined if `joinable` is set.
+SpaceId Fork(int joinable);
+
 /// Only return once the the user program `id` has finished.
 ///
 /// Return the exit status.
 int Join(SpaceId id);
 
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
-
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// User-level thread operations: `Yield`.
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
 void Yield();
 
 
-/// File system operations: `Create`, `Open`, `Read`, `Write`, `Close`.
+/// File system operations: `Create`, `Open`, `Read`, `Write`, `ReadV`,
+/// `WriteV`, `PRead`, `PWrite`, `Close`.
 ///
 /// These functions are patterned after UNIX -- files represent both files
 /// *and* hardware I/O devices.
@@ -120,6 +131,40 @@ int Write(const char *buffer, int size, OpenFileId id);
 /// wait until you can return at least one character).
 int Read(char *buffer, int size, OpenFileId id);
 
+/// A segment of user memory, for `ReadV` and `WriteV`.
+struct IoVec {
+    char *buffer;
+    int size;
+};
+
+/// Write the `count` segments of `vector` to the open file, in order, in a
+/// single system call.  At most `MAX_IOVEC` segments can be given.
+///
+/// Return the number of bytes written, or -1 on error.
+int WriteV(const struct IoVec *vector, int count, OpenFileId id);
+
+/// Read from the open file into the `count` segments of `vector`, filling
+/// them in order, in a single system call.  At most `MAX_IOVEC` segments
+/// can be given.
+///
+/// Return the number of bytes read; like with `Read`, it is less than the
+/// total size if the file is not long enough.
+int ReadV(const struct IoVec *vector, int count, OpenFileId id);
+
+/// Write `size` bytes from `buffer` to the open file, starting at
+/// `position`, without moving the current position of the file.
+///
+/// Return the number of bytes written, or -1 on error.  The console has no
+/// positions, so it cannot be written to this way.
+int PWrite(const char *buffer, int size, int position, OpenFileId id);
+
+/// Read `size` bytes from the open file into `buffer`, starting at
+/// `position`, without moving the current position of the file.
+///
+/// Return the number of bytes read, or -1 on error.  The console has no
+/// positions, so it cannot be read from this way.
+int PRead(char *buffer, int size, int position, OpenFileId id);
+
 /// Close the file, we are done reading and writing to it.
 int Close(OpenFileId id);
 
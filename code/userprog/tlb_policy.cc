@@ -0,0 +1,120 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tlb_policy.hh"
+#include "address_space.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+#ifdef USE_TLB
+
+TlbPolicy::~TlbPolicy()
+{}
+
+TlbPolicy *
+TlbPolicy::Create(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    if (!strcmp(name, "rr")) {
+        return new RoundRobinTlbPolicy;
+    } else if (!strcmp(name, "random")) {
+        return new RandomTlbPolicy;
+    } else if (!strcmp(name, "clock")) {
+        return new ClockTlbPolicy;
+    } else if (!strcmp(name, "lru")) {
+        return new LruTlbPolicy;
+    }
+    return nullptr;
+}
+
+RoundRobinTlbPolicy::RoundRobinTlbPolicy()
+{
+    next = 0;
+}
+
+unsigned
+RoundRobinTlbPolicy::PickVictim()
+{
+    unsigned victim = next;
+    next = (next + 1) % TLB_SIZE;
+    stats->numTlbEntriesExamined++;
+    return victim;
+}
+
+const char *
+RoundRobinTlbPolicy::GetName() const
+{
+    return "rr";
+}
+
+unsigned
+RandomTlbPolicy::PickVictim()
+{
+    stats->numTlbEntriesExamined++;
+    return SystemDep::Random() % TLB_SIZE;
+}
+
+const char *
+RandomTlbPolicy::GetName() const
+{
+    return "random";
+}
+
+ClockTlbPolicy::ClockTlbPolicy()
+{
+    hand = 0;
+}
+
+/// The `use` bit of an entry is saved into the page table before it is
+/// cleared, so that page replacement still sees the reference.
+unsigned
+ClockTlbPolicy::PickVictim()
+{
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (;;) {
+        TranslationEntry *e = &tlb[hand];
+        unsigned current = hand;
+        hand = (hand + 1) % TLB_SIZE;
+        stats->numTlbEntriesExamined++;
+        if (!e->valid || !e->use) {
+            return current;
+        }
+        AddressSpace::ClearTlbUse(current);
+    }
+}
+
+const char *
+ClockTlbPolicy::GetName() const
+{
+    return "clock";
+}
+
+unsigned
+LruTlbPolicy::PickVictim()
+{
+    MMU *mmu = machine->GetMMU();
+    unsigned victim = 0;
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        stats->numTlbEntriesExamined++;
+        if (!mmu->tlb[i].valid) {
+            return i;
+        }
+        if (mmu->GetTlbLastUse(i) < mmu->GetTlbLastUse(victim)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+const char *
+LruTlbPolicy::GetName() const
+{
+    return "lru";
+}
+
+#endif
@@ -0,0 +1,72 @@
+/// Replacement policies for the TLB.
+///
+/// When a TLB miss has to be refilled, the kernel asks the policy in
+/// `tlbPolicy` which entry to replace.  The policy is chosen at startup
+/// with the `-tlb` option.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_TLBPOLICY__HH
+#define NACHOS_USERPROG_TLBPOLICY__HH
+
+
+/// Abstract interface for TLB replacement policies.
+class TlbPolicy {
+public:
+    virtual ~TlbPolicy();
+
+    /// Return the index of the TLB entry to load a new translation into.
+    virtual unsigned PickVictim() = 0;
+
+    /// Return the name the policy is selected by.
+    virtual const char *GetName() const = 0;
+
+    /// Create the policy called `name`: `rr` (round-robin), `random`,
+    /// `clock` or `lru`.
+    ///
+    /// Return null if there is no such policy.
+    static TlbPolicy *Create(const char *name);
+};
+
+/// Replace entries in order, one after the other.
+class RoundRobinTlbPolicy : public TlbPolicy {
+public:
+    RoundRobinTlbPolicy();
+    unsigned PickVictim();
+    const char *GetName() const;
+
+private:
+    unsigned next;  ///< Entry to replace next.
+};
+
+/// Replace any entry, chosen at random.
+class RandomTlbPolicy : public TlbPolicy {
+public:
+    unsigned PickVictim();
+    const char *GetName() const;
+};
+
+/// Sweep the entries with a clock hand, giving a second chance to those
+/// whose `use` bit is set.
+class ClockTlbPolicy : public TlbPolicy {
+public:
+    ClockTlbPolicy();
+    unsigned PickVictim();
+    const char *GetName() const;
+
+private:
+    unsigned hand;  ///< Entry the sweep goes on from.
+};
+
+/// Replace the entry that was used least recently, according to the
+/// MMU.
+class LruTlbPolicy : public TlbPolicy {
+public:
+    unsigned PickVictim();
+    const char *GetName() const;
+};
+
+
+#endif
@@ -7,6 +7,8 @@
 #include "lib/utility.hh"
 #include "threads/system.hh"
 
+#include <string.h>
+
 #ifdef VMEM
 static const int MAX_MEM_TRIES = 3;
 #else
@@ -14,28 +16,72 @@ static const int MAX_MEM_TRIES = 1;
 #endif
 
 
-void ReadBufferFromUser(int userAddress, char *outBuffer,
+/// Return where user address `userAddress` is in main memory, for reading
+/// or writing the rest of its page.
+///
+/// With virtual memory, the page may need to be brought in and then, for a
+/// write, to be copied, before the translation succeeds.  That is done here
+/// rather than by the exception handlers, so that running out of memory
+/// returns null to the system call, which can then release what it holds
+/// before the process exits.
+static char *
+TranslateUserAddress(int userAddress, bool writing)
+{
+    unsigned physicalAddress;
+    ExceptionType e = NO_EXCEPTION;
+    for (int tries = 0; tries < MAX_MEM_TRIES; tries++)
+    {
+        e = machine->GetMMU()->TranslatePage(userAddress, writing,
+                                             &physicalAddress);
+        if (e == NO_EXCEPTION) {
+            break;
+        }
+        unsigned vpn = (unsigned) userAddress / PAGE_SIZE;
+        if (e == PAGE_FAULT_EXCEPTION) {
+            if (!currentThread->space->HandlePageFault(vpn)) {
+                return nullptr;
+            }
+        } else if (e == READ_ONLY_EXCEPTION
+                     && currentThread->space->CopyOnWrite(vpn)) {
+            continue;
+        } else if (currentThread->space->IsOutOfMemory()) {
+            return nullptr;
+        } else {
+            machine->RaiseException(e, userAddress);
+        }
+    }
+    ASSERT(e == NO_EXCEPTION);
+    return machine->GetMMU()->mainMemory + physicalAddress;
+}
+
+/// Return how many of `byteCount` bytes starting at `userAddress` lie in
+/// the same page.
+static unsigned
+BytesInPage(int userAddress, unsigned byteCount)
+{
+    unsigned left = PAGE_SIZE - (unsigned) userAddress % PAGE_SIZE;
+    return byteCount < left ? byteCount : left;
+}
+
+bool ReadBufferFromUser(int userAddress, char *outBuffer,
                         unsigned byteCount)
 {
     ASSERT(userAddress != 0);
     ASSERT(outBuffer != nullptr);
     ASSERT(byteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp;
-        count++;
-        bool valid = false;
-        for (int tries = 0; tries < MAX_MEM_TRIES && !valid; tries++)
-        {
-            valid = machine->ReadMem(userAddress, 1, &temp);
+    while (byteCount > 0) {
+        unsigned chunk = BytesInPage(userAddress, byteCount);
+        const char *from = TranslateUserAddress(userAddress, false);
+        if (from == nullptr) {
+            return false;
         }
-        ASSERT(valid);
-        userAddress++;
-        *outBuffer++ = (unsigned char) temp;
-    } while (count < byteCount);
-
-
+        memcpy(outBuffer, from, chunk);
+        userAddress += chunk;
+        outBuffer += chunk;
+        byteCount -= chunk;
+    }
+    return true;
 }
 
 bool ReadStringFromUser(int userAddress, char *outString,
@@ -45,56 +91,50 @@ bool ReadStringFromUser(int userAddress, char *outString,
     ASSERT(outString != nullptr);
     ASSERT(maxByteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp;
-        count++;
-        bool valid = false;
-        for (int tries = 0; tries < MAX_MEM_TRIES && !valid; tries++)
-        {
-            valid = machine->ReadMem(userAddress, 1, &temp);
+    while (maxByteCount > 0) {
+        unsigned chunk = BytesInPage(userAddress, maxByteCount);
+        const char *from = TranslateUserAddress(userAddress, false);
+        if (from == nullptr) {
+            return false;
+        }
+        const char *end = (const char *) memchr(from, '\0', chunk);
+        if (end != nullptr) {
+            memcpy(outString, from, end - from + 1);
+            return true;
         }
-        ASSERT(valid);
-        userAddress++;
-        *outString = (unsigned char) temp;
-    } while (*outString++ != '\0' && count < maxByteCount);
-    return *(outString - 1) == '\0';
+        memcpy(outString, from, chunk);
+        userAddress += chunk;
+        outString += chunk;
+        maxByteCount -= chunk;
+    }
+    return false;
 }
 
-void WriteBufferToUser(const char *buffer, int userAddress,
+bool WriteBufferToUser(const char *buffer, int userAddress,
                        unsigned byteCount)
 {
     ASSERT(userAddress != 0);
     ASSERT(buffer != nullptr);
     ASSERT(byteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp;
-        temp = (int)(buffer[count++]);
-        bool valid = false;
-        for (int tries = 0; tries < MAX_MEM_TRIES && !valid; tries++)
-        {
-            valid = machine->WriteMem(userAddress, 1, temp);
+    while (byteCount > 0) {
+        unsigned chunk = BytesInPage(userAddress, byteCount);
+        char *to = TranslateUserAddress(userAddress, true);
+        if (to == nullptr) {
+            return false;
         }
-        ASSERT(valid);
-        userAddress++;
-    } while (count < byteCount);
+        memcpy(to, buffer, chunk);
+        userAddress += chunk;
+        buffer += chunk;
+        byteCount -= chunk;
+    }
+    return true;
 }
 
-void WriteStringToUser(const char *string, int userAddress)
+bool WriteStringToUser(const char *string, int userAddress)
 {
     ASSERT(userAddress != 0);
     ASSERT(string != nullptr);
 
-    do {
-        int temp = (int) *string;
-        bool valid = false;
-        for (int tries = 0; tries < MAX_MEM_TRIES && !valid; tries++)
-        {
-            valid = machine->WriteMem(userAddress, 1, temp);
-        }
-        ASSERT(valid);
-        userAddress++;
-    } while (*string++ != '\0');
+    return WriteBufferToUser(string, userAddress, strlen(string) + 1);
 }
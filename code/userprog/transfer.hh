@@ -7,20 +7,25 @@
 #define NACHOS_USERPROG_TRANSFER__HH
 
 
+/// Every function here returns false if a page of user memory could not be
+/// brought in.  The copy is then left unfinished, and the process is to
+/// exit, as `AddressSpace::IsOutOfMemory` tells.
+
 /// Copy a byte array from virtual machine to host.
-void ReadBufferFromUser(int userAddress, char *outBuffer,
+bool ReadBufferFromUser(int userAddress, char *outBuffer,
                         unsigned byteCount);
 
-/// Copy a C string from virtual machine to host.
+/// Copy a C string from virtual machine to host.  Also return false if the
+/// string does not fit.
 bool ReadStringFromUser(int userAddress, char *outString,
                         unsigned maxByteCount);
 
 /// Copy a byte array from host to virtual machine.
-void WriteBufferToUser(const char *buffer, int userAddress,
+bool WriteBufferToUser(const char *buffer, int userAddress,
                        unsigned byteCount);
 
 /// Copy a C string from host to virtual machine.
-void WriteStringToUser(const char *string, int userAddress);
+bool WriteStringToUser(const char *string, int userAddress);
 
 
 #endif